@@ -1,6 +1,7 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <psp2/appmgr.h>
+#include <psp2/io/stat.h>
 #include <psp2/kernel/clib.h>
 #include <psp2/kernel/processmgr.h>
 #include <psp2/kernel/threadmgr/thread.h>
@@ -11,11 +12,17 @@
 
 #include <libmouse.h>
 
-#define TSF_IMPLEMENTATION
-#include "tsf.h"
+#include <engine.h>
+#include <input.h>
+#include <topology.h>
 
 #define printf sceClibPrintf
 
+#define DATA_DIR "ux0:data/MoUSE"
+#define REPLAY_PATH DATA_DIR "/replay.mcap"
+#define CAPTURE_PATH DATA_DIR "/capture.mcap"
+#define LATENCY_PATH DATA_DIR "/latency.txt"
+
 unsigned int _newlib_heap_size_user = 220 * 1024 * 1024;
 
 static SDL_Window *g_window        = NULL;
@@ -27,9 +34,11 @@ static SDL_Texture *g_tex_particle_star = NULL;
 static SDL_Texture *g_tex_particle_spot = NULL;
 static SDL_Thread *g_thread;
 static uint32_t g_last_tick = 0;
+static uint8_t g_audio_placed = 0;
+static int g_audio_samples = 0;
+static uint32_t g_boot_tick = 0;
 
-SDL_mutex* g_mutex;
-tsf* g_tsf;
+engine* g_engine;
 
 static int g_mode                  = 1;
 static int g_preset                = 0;
@@ -54,18 +63,6 @@ particle particles[256] = {0};
 static Uint64 SDL_rand_state;
 static uint8_t SDL_rand_initialized = 0;
 
-enum MidiMessageType
-{
-    MIDI_NOTE_OFF = 0x80,
-    MIDI_NOTE_ON = 0x90,
-    MIDI_KEY_PRESSURE = 0xA0,
-    MIDI_CONTROL_CHANGE = 0xB0,
-    MIDI_PROGRAM_CHANGE = 0xC0,
-    MIDI_CHANNEL_PRESSURE = 0xD0,
-    MIDI_PITCH_BEND = 0xE0,
-    MIDI_SET_TEMPO = 0x51
-};
-
 void SDL_srand(Uint64 seed)
 {
     if (!seed) {
@@ -150,9 +147,74 @@ static void AudioCallback(void* data, Uint8 *stream, int len)
 {
     // Render the audio samples in float format
     int SampleCount = (len / (2 * sizeof(uint16_t))); //2 output channels
-    SDL_LockMutex(g_mutex); //get exclusive lock
-    tsf_render_short(g_tsf, (uint16_t*)stream, SampleCount, 0);
-    SDL_UnlockMutex(g_mutex);
+    if (!g_audio_placed)
+    {
+        // SDL owns the audio thread, so place it from the first callback
+        topology_apply(TOPOLOGY_AUDIO);
+        g_audio_placed = 1;
+    }
+    engine_render_s16(g_engine, (int16_t*)stream, SampleCount);
+}
+
+static void spawnParticle(void *user, const engine_event *ev);
+int updateMidiInput(void *data);
+
+// Startup assets are decoded on worker threads while the main thread shows a splash.
+// Textures still have to be created on the render thread, so workers only hand over surfaces.
+typedef struct
+{
+  const char *path;
+  SDL_Texture **texture;
+  SDL_Surface *surface;
+  SDL_atomic_t state; // 0 pending, 1 decoded, -1 failed
+} image_job;
+
+static image_job g_images[] = {
+  {"data/inactive.bmp", &g_tex_inactive},
+  {"data/active.bmp", &g_tex_active},
+  {"data/star.png", &g_tex_particle_star},
+  {"data/spot.png", &g_tex_particle_spot},
+  {"data/connect.png", &g_tex_connect},
+};
+
+#define IMAGE_COUNT (int)(sizeof(g_images) / sizeof(g_images[0]))
+#define LOADER_THREADS 3
+
+static SDL_atomic_t g_next_job;   // job 0 is the soundfont, the rest are images
+static SDL_atomic_t g_font_state; // 0 loading, 1 ready, -1 failed
+static int g_audio_started = 0;
+
+static void loadFont()
+{
+  engine_config cfg;
+  engine_config_defaults(&cfg);
+  cfg.sample_rate = 44100;
+  cfg.font_cache  = DATA_DIR "/font.tsfc";
+
+  g_engine = engine_create(&cfg);
+  SDL_AtomicSet(&g_font_state, g_engine ? 1 : -1);
+}
+
+static void decodeImage(image_job *job)
+{
+  // IMG_Load handles bmp as well
+  job->surface = IMG_Load(job->path);
+  SDL_AtomicSet(&job->state, job->surface ? 1 : -1);
+}
+
+static int loaderThread(void *data)
+{
+  topology_apply(TOPOLOGY_LOADER);
+
+  int job;
+  while ((job = SDL_AtomicAdd(&g_next_job, 1)) <= IMAGE_COUNT)
+  {
+    if (job == 0)
+      loadFont();
+    else
+      decodeImage(&g_images[job - 1]);
+  }
+  return 0;
 }
 
 int init()
@@ -161,9 +223,29 @@ int init()
   SDL_SetHint(SDL_HINT_TOUCH_MOUSE_EVENTS, "0");
   SDL_SetHint(SDL_HINT_MOUSE_TOUCH_EVENTS, "0");
 
-  if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0)
     return -1;
 
+  topology_defaults();
+  if (topology_load("data/topology.txt") < 0)
+    sceClibPrintf("topology: ignoring malformed entries\n");
+
+  int flags = IMG_INIT_PNG;
+  int initted = IMG_Init(flags);
+  if((initted & flags) != flags) {
+    fprintf(stderr, "IMG_Init: Failed to init required png support: {}", IMG_GetError());
+    return -1;
+  }
+
+  // get the soundfont going first, it takes the longest
+  for (int i = 0; i < LOADER_THREADS; i++)
+  {
+    SDL_Thread *thread = SDL_CreateThread(loaderThread, "loader", NULL);
+    if (!thread)
+      return -1;
+    SDL_DetachThread(thread);
+  }
+
   if ((g_window
        = SDL_CreateWindow("MoUSE", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 960, 544, SDL_WINDOW_SHOWN))
       == NULL)
@@ -180,98 +262,100 @@ int init()
   SDL_GetVersion(&ver);
   sceClibPrintf("using: %d.%d.%d sdl\n", ver.major,ver.minor,ver.patch);
 
-  int flags = IMG_INIT_PNG;
-  int initted = IMG_Init(flags);
-  if((initted & flags) != flags) {
-    fprintf(stderr, "IMG_Init: Failed to init required png support: {}", IMG_GetError());
-    return -1;
-  }
-
-
-  SDL_Surface *temp = SDL_LoadBMP("data/inactive.bmp");
-  if (!temp)
-    return -1;
-  g_tex_inactive = SDL_CreateTextureFromSurface(g_renderer, temp);
-  if (!g_tex_inactive)
-    return -1;
-  SDL_FreeSurface(temp);
-
-  temp = SDL_LoadBMP("data/active.bmp");
-  if (!temp)
-    return -1;
-  g_tex_active = SDL_CreateTextureFromSurface(g_renderer, temp);
-  if (!g_tex_active)
-    return -1;
-  SDL_FreeSurface(temp);
-
-  temp = IMG_Load("data/star.png");
-  if (!temp)
-    return -1;
-  g_tex_particle_star = SDL_CreateTextureFromSurface(g_renderer, temp);
-  if (!g_tex_particle_star)
-    return -1;
-  SDL_FreeSurface(temp);
-
-  temp = IMG_Load("data/spot.png");
-  if (!temp)
-    return -1;
-  g_tex_particle_spot = SDL_CreateTextureFromSurface(g_renderer, temp);
-  if (!g_tex_particle_spot)
-    return -1;
-  SDL_FreeSurface(temp);
-
-  temp = IMG_Load("data/connect.png");
-  if (!temp)
-    return -1;
-  g_tex_connect = SDL_CreateTextureFromSurface(g_renderer, temp);
-  if (!g_tex_connect)
-    return -1;
-  SDL_FreeSurface(temp);
-
-
   SDL_GameControllerOpen(0);
 
   SDL_srand(0);
 
+  return 0;
+}
+
+static int startAudio()
+{
   SDL_AudioSpec OutputAudioSpec;
-  OutputAudioSpec.freq = 44100;
+  OutputAudioSpec.freq = engine_sample_rate(g_engine);
   OutputAudioSpec.format = AUDIO_S16;
   OutputAudioSpec.channels = 2;
   OutputAudioSpec.samples = 4096;
   OutputAudioSpec.callback = AudioCallback;
 
-  g_tsf = tsf_load_filename("data/florestan-subset.sf2");
-  if (!g_tsf)
-  {
-    fprintf(stderr, "Could not load SoundFont\n");
-    return -1;
-  }
-
-  for (int i = 0; i < 32; i++)
-  {
-      tsf_channel_set_volume(g_tsf, i, 1.0f);
-      tsf_channel_set_bank_preset(g_tsf, i, i, 0);
-  }
-
-  // Set the SoundFont rendering output mode
-  tsf_set_output(g_tsf, TSF_STEREO_INTERLEAVED, OutputAudioSpec.freq, 0.0f);
-
-  g_mutex = SDL_CreateMutex();
-
   // Request the desired audio output format
   if (SDL_OpenAudio(&OutputAudioSpec, 0) < 0)
   {
     fprintf(stderr, "Could not open the audio hardware or the desired audio output format\n");
-    return -11;
+    return -1;
   }
 
+  g_audio_samples = OutputAudioSpec.samples;
+
+  engine_set_event_callback(g_engine, spawnParticle, particles);
+
   // Start the actual audio playback here
   // The audio thread will begin to call our AudioCallback function
   SDL_PauseAudio(0);
 
+  // because usb read is blocking we do it on separate thread
+  g_thread = SDL_CreateThread(updateMidiInput, "midi", NULL);
+
+  sceClibPrintf("playable after %u ms\n", SDL_GetTicks() - g_boot_tick);
   return 0;
 }
 
+// Picks up whatever the loaders finished. Returns 1 once everything is in, -1 on failure.
+static int updateLoading()
+{
+  int done = 0;
+
+  int font = SDL_AtomicGet(&g_font_state);
+  if (font < 0)
+    return -1;
+  if (font > 0)
+  {
+    if (!g_audio_started)
+    {
+      if (startAudio() < 0)
+        return -1;
+      g_audio_started = 1;
+    }
+    done++;
+  }
+
+  for (int i = 0; i < IMAGE_COUNT; i++)
+  {
+    image_job *job = &g_images[i];
+    int state      = SDL_AtomicGet(&job->state);
+    if (state < 0)
+      return -1;
+    if (state > 0 && job->surface)
+    {
+      *job->texture = SDL_CreateTextureFromSurface(g_renderer, job->surface);
+      SDL_FreeSurface(job->surface);
+      job->surface = NULL;
+      if (!*job->texture)
+        return -1;
+    }
+    if (*job->texture)
+      done++;
+  }
+
+  return done == IMAGE_COUNT + 1;
+}
+
+static void drawSplash()
+{
+  int loaded = SDL_AtomicGet(&g_font_state) > 0;
+  for (int i = 0; i < IMAGE_COUNT; i++)
+    loaded += *g_images[i].texture != NULL;
+
+  SDL_Rect frame = {280, 262, 400, 20};
+  SDL_Rect bar   = {284, 266, 392 * loaded / (IMAGE_COUNT + 1), 12};
+  SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 255);
+  SDL_RenderClear(g_renderer);
+  SDL_SetRenderDrawColor(g_renderer, 255, 255, 255, 255);
+  SDL_RenderDrawRect(g_renderer, &frame);
+  SDL_RenderFillRect(g_renderer, &bar);
+  SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 255);
+}
+
 void start()
 {
   g_mode = 1;
@@ -282,75 +366,78 @@ void stop()
   g_mode = 0;
 }
 
-int updateMidiInput(void *data)
+static void spawnParticle(void *user, const engine_event *ev)
 {
-    particle* pparticles = (particle*)data;
-    while(1)
+    particle* pparticles = (particle*)user;
+    if (ev->type != MIDI_NOTE_ON || !ev->data2)
+        return;
+
+    for(int i = 0; i < 256; i ++)
     {
-      if (libmouse_usb_in_attached())
-      {
-        uint8_t reply[64] = {0};
-        int res = libmouse_usb_read(reply, 64);
-        if (res < 0)
+        if (!pparticles[i].alive)
         {
+
+            pparticles[i].alive = 1;
+            pparticles[i].angle = 0;
+            pparticles[i].x = SDL_rand(960);
+            pparticles[i].y = SDL_rand(544);
+            pparticles[i].radius = ((float)ev->data2 / 127.0f) * 2.f;
+            pparticles[i].r = SDL_rand(255);
+            pparticles[i].g = SDL_rand(255);
+            pparticles[i].b = SDL_rand(255);
+            pparticles[i].type = SDL_rand(100) > 50;
+            pparticles[i].lifetime = 1500;
+
+            pparticles[i].note = ev->data1;
+            break;
         }
-        else
-        {
-            uint8_t cmd = reply[1] & 0xF0;
-            uint8_t channel = reply[1] & 0x0F;
+    }
+}
 
-            switch(cmd)
-            {
-                case MIDI_NOTE_ON:
-                    SDL_LockMutex(g_mutex);
-                    tsf_channel_note_on(g_tsf, channel, reply[2] & 0x7F, (float)(reply[3] & 0x7F) / 127.0f);
-                    SDL_UnlockMutex(g_mutex);
-                    for(int i = 0; i < 256; i ++)
-                    {
-                        if (!pparticles[i].alive)
-                        {
-
-                            pparticles[i].alive = 1;
-                            pparticles[i].angle = 0;
-                            pparticles[i].x = SDL_rand(960);
-                            pparticles[i].y = SDL_rand(544);
-                            pparticles[i].radius = ((float)(reply[3] & 0x7F) / 127.0f) * 2.f;
-                            pparticles[i].r = SDL_rand(255);
-                            pparticles[i].g = SDL_rand(255);
-                            pparticles[i].b = SDL_rand(255);
-                            pparticles[i].type = SDL_rand(100) > 50;
-                            pparticles[i].lifetime = 1500;
-
-                            pparticles[i].note = reply[2] & 0x7F;
-                            break;
-                        }
-                    }
-
-
-                    break;
-                case MIDI_NOTE_OFF:
-                    SDL_LockMutex(g_mutex);
-                    tsf_channel_note_off(g_tsf, channel, reply[2] & 0x7F);
-                    SDL_UnlockMutex(g_mutex);
-                    break;
-                case MIDI_CONTROL_CHANGE:
-                    SDL_LockMutex(g_mutex);
-                    tsf_channel_midi_control(g_tsf, channel, reply[2] & 0x7F, reply[3] & 0x7F);
-                    SDL_UnlockMutex(g_mutex);
-                    break;
-                case MIDI_PITCH_BEND:
-                    SDL_LockMutex(g_mutex);
-                    tsf_channel_set_pitchwheel(g_tsf, channel, (reply[3] & 0x7F) << 7 | (reply[2] & 0x7F));
-                    SDL_UnlockMutex(g_mutex);
-                    break;
-                default:
-                    break;
-            }
+// feeds the engine until the source ends, then closes it
+static void feedMidiInput(struct engine_input *in)
+{
+    engine_timed_event events[16];
+    int count;
+    while ((count = in->read(in->data, events, 16)) != ENGINE_INPUT_END)
+      engine_feed(g_engine, events, count);
 
-        }
+    in->close(in->data);
+}
 
-      }
-    }
+int updateMidiInput(void *data)
+{
+    struct engine_input in;
+    topology_apply(TOPOLOGY_MIDI);
+
+    // a capture dropped in the data folder plays first, handy to reproduce a session, then usb takes over
+    if (engine_input_replay(&in, REPLAY_PATH, 1) >= 0)
+      feedMidiInput(&in);
+
+    engine_input_usb(&in);
+    feedMidiInput(&in);
+    return 0;
+}
+
+// play isolated notes while measuring, the report lands in LATENCY_PATH when stopped
+void toggleLatency()
+{
+  engine_latency_report report;
+  if (engine_latency_get(g_engine, &report) < 0)
+  {
+    // SDL hands us the next buffer to fill while the current one plays
+    engine_latency_start(g_engine, g_audio_samples);
+    return;
+  }
+
+  engine_latency_stop(g_engine);
+  sceIoMkdir(DATA_DIR, 0777);
+  FILE *f = fopen(LATENCY_PATH, "w");
+  if (f)
+  {
+    engine_latency_print(&report, f);
+    fclose(f);
+  }
 }
 
 void pollInput()
@@ -373,21 +460,33 @@ void pollInput()
           {
             stop();
           }
+          if (event.cbutton.button == SDL_CONTROLLER_BUTTON_Y)
+          {
+            if (engine_capturing(g_engine))
+              engine_capture_stop(g_engine);
+            else
+            {
+              sceIoMkdir(DATA_DIR, 0777);
+              engine_capture_start(g_engine, CAPTURE_PATH);
+            }
+          }
+          if (event.cbutton.button == SDL_CONTROLLER_BUTTON_X)
+            toggleLatency();
           if (event.cbutton.button == SDL_CONTROLLER_BUTTON_LEFTSHOULDER)
           {
             g_preset--;
             if (g_preset < 0)
-               g_preset = tsf_get_presetcount(g_tsf) - 1;
+               g_preset = engine_preset_count(g_engine) - 1;
 
-            tsf_channel_set_presetindex(g_tsf, 0, g_preset);
+            engine_set_preset(g_engine, 0, g_preset);
           }
           if (event.cbutton.button == SDL_CONTROLLER_BUTTON_RIGHTSHOULDER)
           {
             g_preset++;
-            if (g_preset >= tsf_get_presetcount(g_tsf))
+            if (g_preset >= engine_preset_count(g_engine))
                g_preset = 0;
 
-            tsf_channel_set_presetindex(g_tsf, 0, g_preset);
+            engine_set_preset(g_engine, 0, g_preset);
           }
         }
         break;
@@ -451,6 +550,7 @@ void drawParticles()
 
 int main(int argc, char *argv[])
 {
+  g_boot_tick = SDL_GetTicks();
 
   if (init() < 0)
     return 0;
@@ -467,8 +567,27 @@ int main(int argc, char *argv[])
   //libmouse_udcd_stop();
   libmouse_usb_start();
 
-  // because usb read is blocking we do it on separate thread
-  SDL_CreateThread(updateMidiInput, "midi", particles);
+  topology_apply(TOPOLOGY_UI);
+
+  int loaded = 0;
+  while (!loaded)
+  {
+    loaded = updateLoading();
+    if (loaded < 0)
+    {
+      SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Loading failed", "Could not load data files", g_window);
+      return -1;
+    }
+
+    // notes already play here, buttons wait for the ui
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+      ;
+
+    drawSplash();
+    SDL_RenderPresent(g_renderer);
+    SDL_Delay(1); // yield
+  }
 
   g_last_tick = SDL_GetTicks();
 
@@ -497,6 +616,7 @@ int main(int argc, char *argv[])
   SDL_DestroyRenderer(g_renderer);
   SDL_DestroyWindow(g_window);
 
+  engine_destroy(g_engine);
   SDL_Quit();
   return 0;
 }
@@ -0,0 +1,180 @@
+#include "input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct engine_capture
+{
+  FILE *f;
+  uint64_t last_us;
+  int started;
+};
+
+engine_capture *engine_capture_open(const char *path)
+{
+  engine_capture *cap = calloc(1, sizeof(engine_capture));
+  if (!cap)
+    return NULL;
+
+  cap->f = fopen(path, "wb");
+  if (!cap->f)
+  {
+    free(cap);
+    return NULL;
+  }
+
+  const uint8_t header[8] = {'M', 'C', 'A', 'P', ENGINE_CAPTURE_VERSION, 0, 0, 0};
+  fwrite(header, 1, sizeof(header), cap->f);
+  return cap;
+}
+
+int engine_capture_write(engine_capture *cap, const engine_timed_event *evs, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    uint8_t rec[13];
+    int n = 0;
+
+    uint64_t delta = cap->started && evs[i].time_us > cap->last_us ? evs[i].time_us - cap->last_us : 0;
+    cap->last_us   = evs[i].time_us;
+    cap->started   = 1;
+
+    do
+    {
+      rec[n] = delta & 0x7F;
+      delta >>= 7;
+      if (delta)
+        rec[n] |= 0x80;
+      n++;
+    } while (delta);
+
+    rec[n++] = evs[i].ev.type | evs[i].ev.channel;
+    rec[n++] = evs[i].ev.data1;
+    rec[n++] = evs[i].ev.data2;
+
+    if (fwrite(rec, 1, n, cap->f) != (size_t)n)
+      return -1;
+  }
+  return 0;
+}
+
+void engine_capture_close(engine_capture *cap)
+{
+  if (!cap)
+    return;
+  fclose(cap->f);
+  free(cap);
+}
+
+struct replay
+{
+  uint8_t *data;
+  size_t size, pos;
+  int realtime;
+  uint64_t time_us; // recorded time of the next event, relative to the first
+  uint64_t start_us;
+};
+
+static int _replay_read(void *data, engine_timed_event *out, int max)
+{
+  struct replay *r = data;
+  int count        = 0;
+
+  while (count < max && r->pos < r->size)
+  {
+    size_t pos     = r->pos;
+    uint64_t delta = 0;
+    int shift      = 0;
+    while (pos < r->size && r->data[pos] & 0x80 && shift < 63)
+    {
+      delta |= (uint64_t)(r->data[pos++] & 0x7F) << shift;
+      shift += 7;
+    }
+    if (pos + 4 > r->size)
+    {
+      r->pos = r->size; // truncated record
+      break;
+    }
+    delta |= (uint64_t)r->data[pos++] << shift;
+
+    uint64_t at = r->time_us + delta;
+    if (r->realtime)
+    {
+      // hand out what is due, then wait for the next one
+      uint64_t now = engine_now_us() - r->start_us;
+      if (at > now)
+      {
+        if (count)
+          break;
+        // long gaps are waited out over several calls, so a reader thread can be stopped
+        if (at - now > ENGINE_INPUT_WAIT_US)
+        {
+          engine_sleep_us(ENGINE_INPUT_WAIT_US);
+          return 0;
+        }
+        engine_sleep_us(at - now);
+      }
+    }
+
+    out[count].time_us    = r->realtime ? engine_now_us() : at;
+    out[count].ev.type    = r->data[pos] & 0xF0;
+    out[count].ev.channel = r->data[pos] & 0x0F;
+    out[count].ev.data1   = r->data[pos + 1] & 0x7F;
+    out[count].ev.data2   = r->data[pos + 2] & 0x7F;
+    count++;
+
+    r->time_us = at;
+    r->pos     = pos + 3;
+  }
+
+  if (!count && r->pos >= r->size)
+    return ENGINE_INPUT_END;
+  return count;
+}
+
+static void _replay_close(void *data)
+{
+  struct replay *r = data;
+  free(r->data);
+  free(r);
+}
+
+int engine_input_replay(struct engine_input *in, const char *path, int realtime)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return -1;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  struct replay *r = calloc(1, sizeof(struct replay));
+  if (!r || size < 8)
+  {
+    free(r);
+    fclose(f);
+    return -1;
+  }
+
+  r->data = malloc(size);
+  if (!r->data || fread(r->data, 1, size, f) != (size_t)size || memcmp(r->data, "MCAP", 4) || r->data[4] != ENGINE_CAPTURE_VERSION)
+  {
+    free(r->data);
+    free(r);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+
+  r->size     = size;
+  r->pos      = 8;
+  r->realtime = realtime;
+  r->start_us = engine_now_us();
+
+  in->data  = r;
+  in->read  = _replay_read;
+  in->close = _replay_close;
+  return 0;
+}
@@ -0,0 +1,446 @@
+#include "engine.h"
+#include "input.h"
+#include "latency.h"
+#include "topology.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __vita__
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr/thread.h>
+#else
+#include <time.h>
+#endif
+
+// 16-bit samples in memory: half the heap for the font, so full GM banks fit on the vita
+#define TSF_SAMPLES_SHORT
+// -DMOUSE_RT_ASSERT=ON builds stop when the synth allocates on the audio or midi path with max_voices set
+#ifdef MOUSE_RT_ASSERT
+#undef NDEBUG // in any build type
+#include <assert.h>
+#define TSF_RT_ASSERT(x) assert(x)
+#endif
+// render timing for engine_get_stats, in microseconds
+#define TSF_CLOCK() engine_now_us()
+#define TSF_IMPLEMENTATION
+#include "tsf.h"
+
+// voices streaming at once, each with a ring of TSF_STREAM_RING samples
+#define ENGINE_STREAM_RINGS 64
+
+struct engine
+{
+  tsf *tsf;
+  pthread_mutex_t lock;
+  engine_config cfg;
+
+  engine_event_cb on_event;
+  void *user;
+
+  pthread_mutex_t capture_lock;
+  engine_capture *capture;
+
+  latency_probe *latency;
+
+  // disk streaming: the thread reading ahead and the lock keeping it off the file while presets page in
+  pthread_t stream_thread;
+  pthread_mutex_t stream_lock;
+  volatile int stream_stop;
+  int streaming;
+};
+
+void engine_config_defaults(engine_config *cfg)
+{
+  cfg->font_path   = "data/florestan-subset.sf2";
+  cfg->font_cache  = NULL;
+  cfg->sample_rate = 44100;
+  cfg->channels    = 32;
+  cfg->gain_db     = 0.0f;
+  cfg->max_voices     = 128;
+  cfg->lazy_samples   = 0;
+  cfg->stream_head_ms = 0;
+}
+
+// reads ahead for the streaming voices, resting while every ring is full
+static void *_stream_thread(void *data)
+{
+  engine *e = data;
+  topology_apply(TOPOLOGY_STREAM);
+  while (!e->stream_stop)
+  {
+    pthread_mutex_lock(&e->stream_lock);
+    int read = tsf_stream_update(e->tsf);
+    pthread_mutex_unlock(&e->stream_lock);
+    if (!read)
+      engine_sleep_us(2000);
+  }
+  return NULL;
+}
+
+// loads the compiled font cache if it was compiled from a soundfont of the same size and modification time
+// (or the soundfont is gone), otherwise the soundfont, compiling it into the cache for the next time
+static tsf *_load_font(const engine_config *cfg)
+{
+  struct stat font;
+  long long size, time;
+  if (!cfg->font_cache)
+    return tsf_load_filename(cfg->font_path);
+
+  int font_found = !stat(cfg->font_path, &font);
+  if (tsf_get_compiled_source(cfg->font_cache, &size, &time)
+      && (!font_found || (size == (long long)font.st_size && time == (long long)font.st_mtime)))
+  {
+    tsf *f = tsf_load_compiled(cfg->font_cache);
+    if (f)
+      return f;
+  }
+
+  tsf *f = tsf_load_filename(cfg->font_path);
+  if (f && !tsf_save_compiled(f, cfg->font_cache, font.st_size, font.st_mtime))
+    fprintf(stderr, "Could not write font cache %s\n", cfg->font_cache);
+  return f;
+}
+
+engine *engine_create(const engine_config *cfg)
+{
+  engine *e = calloc(1, sizeof(engine));
+  if (!e)
+    return NULL;
+  e->cfg = *cfg;
+
+  int paged = cfg->lazy_samples || cfg->stream_head_ms > 0;
+  e->tsf    = paged ? tsf_load_filename_paged(cfg->font_path) : _load_font(cfg);
+  if (!e->tsf)
+  {
+    fprintf(stderr, "Could not load SoundFont %s\n", cfg->font_path);
+    free(e);
+    return NULL;
+  }
+  if (cfg->stream_head_ms > 0 && !tsf_set_streaming(e->tsf, cfg->stream_head_ms, ENGINE_STREAM_RINGS))
+  {
+    fprintf(stderr, "Could not allocate stream buffers\n");
+    tsf_close(e->tsf);
+    free(e);
+    return NULL;
+  }
+
+  for (int i = 0; i < cfg->channels; i++)
+  {
+    tsf_channel_set_volume(e->tsf, i, 1.0f);
+    tsf_channel_set_bank_preset(e->tsf, i, i, 0);
+    if (!tsf_load_preset_samples(e->tsf, tsf_channel_get_preset_index(e->tsf, i)))
+      fprintf(stderr, "Could not load samples for channel %d\n", i);
+  }
+
+  if (cfg->max_voices > 0 && !tsf_set_realtime(e->tsf, cfg->max_voices, cfg->channels))
+  {
+    fprintf(stderr, "Could not allocate %d voices\n", cfg->max_voices);
+    tsf_close(e->tsf);
+    free(e);
+    return NULL;
+  }
+
+  // Set the SoundFont rendering output mode
+  tsf_set_output(e->tsf, TSF_STEREO_INTERLEAVED, cfg->sample_rate, cfg->gain_db);
+
+  pthread_mutex_init(&e->lock, NULL);
+  pthread_mutex_init(&e->capture_lock, NULL);
+  pthread_mutex_init(&e->stream_lock, NULL);
+  if (cfg->stream_head_ms > 0)
+  {
+    if (pthread_create(&e->stream_thread, NULL, _stream_thread, e))
+      fprintf(stderr, "Could not start the stream thread, long samples play their head only\n");
+    else
+      e->streaming = 1;
+  }
+  return e;
+}
+
+void engine_destroy(engine *e)
+{
+  if (!e)
+    return;
+  engine_capture_stop(e);
+  engine_latency_stop(e);
+  if (e->streaming)
+  {
+    e->stream_stop = 1;
+    pthread_join(e->stream_thread, NULL);
+  }
+  pthread_mutex_destroy(&e->stream_lock);
+  pthread_mutex_destroy(&e->capture_lock);
+  pthread_mutex_destroy(&e->lock);
+  tsf_close(e->tsf);
+  free(e);
+}
+
+void engine_set_event_callback(engine *e, engine_event_cb cb, void *user)
+{
+  e->on_event = cb;
+  e->user     = user;
+}
+
+int engine_decode_midi(const uint8_t *msg, int len, engine_event *out)
+{
+  if (len < 1 || msg[0] < 0x80 || msg[0] >= 0xF0)
+    return 0;
+
+  out->type    = msg[0] & 0xF0;
+  out->channel = msg[0] & 0x0F;
+  out->data1   = len > 1 ? msg[1] & 0x7F : 0;
+  out->data2   = len > 2 ? msg[2] & 0x7F : 0;
+  return 1;
+}
+
+int engine_decode_usb(const uint8_t *buf, int len, engine_event *out, int max)
+{
+  int count = 0;
+  // a single transfer can carry up to 16 packets, the rest of the buffer is zero padding
+  for (int i = 0; i + 4 <= len && count < max; i += 4)
+  {
+    if (engine_decode_midi(buf + i + 1, 3, &out[count]))
+      count++;
+  }
+  return count;
+}
+
+static void _apply(engine *e, const engine_event *ev, uint64_t time_us)
+{
+  pthread_mutex_lock(&e->lock);
+  switch (ev->type)
+  {
+    case MIDI_NOTE_ON:
+      if (e->latency && ev->data2)
+      {
+        int silent = !tsf_active_voice_count(e->tsf);
+        tsf_channel_note_on(e->tsf, ev->channel, ev->data1, (float)ev->data2 / 127.0f);
+        latency_probe_note_on(e->latency, time_us, engine_now_us(), silent);
+      }
+      else
+        tsf_channel_note_on(e->tsf, ev->channel, ev->data1, (float)ev->data2 / 127.0f);
+      break;
+    case MIDI_NOTE_OFF:
+      tsf_channel_note_off(e->tsf, ev->channel, ev->data1);
+      break;
+    case MIDI_CONTROL_CHANGE:
+      tsf_channel_midi_control(e->tsf, ev->channel, ev->data1, ev->data2);
+      break;
+    case MIDI_PITCH_BEND:
+      tsf_channel_set_pitchwheel(e->tsf, ev->channel, ev->data2 << 7 | ev->data1);
+      break;
+    default:
+      break;
+  }
+  pthread_mutex_unlock(&e->lock);
+
+  if (e->on_event)
+    e->on_event(e->user, ev);
+}
+
+void engine_dispatch(engine *e, const engine_event *ev)
+{
+  _apply(e, ev, e->latency ? engine_now_us() : 0);
+}
+
+void engine_feed(engine *e, const engine_timed_event *evs, int count)
+{
+  if (e->capture)
+  {
+    pthread_mutex_lock(&e->capture_lock);
+    if (e->capture)
+      engine_capture_write(e->capture, evs, count);
+    pthread_mutex_unlock(&e->capture_lock);
+  }
+
+  for (int i = 0; i < count; i++)
+    _apply(e, &evs[i].ev, evs[i].time_us);
+}
+
+int engine_capture_start(engine *e, const char *path)
+{
+  engine_capture *cap = engine_capture_open(path);
+  if (!cap)
+    return -1;
+
+  pthread_mutex_lock(&e->capture_lock);
+  engine_capture *old = e->capture;
+  e->capture          = cap;
+  pthread_mutex_unlock(&e->capture_lock);
+
+  if (old)
+    engine_capture_close(old);
+  return 0;
+}
+
+void engine_capture_stop(engine *e)
+{
+  pthread_mutex_lock(&e->capture_lock);
+  engine_capture *old = e->capture;
+  e->capture          = NULL;
+  pthread_mutex_unlock(&e->capture_lock);
+
+  if (old)
+    engine_capture_close(old);
+}
+
+int engine_capturing(engine *e)
+{
+  return e->capture != NULL;
+}
+
+// first frame with either channel above ~-78dBFS
+#define LATENCY_ONSET_S16 4
+
+void engine_render_s16(engine *e, int16_t *out, int frames)
+{
+  pthread_mutex_lock(&e->lock);
+  tsf_render_short(e->tsf, out, frames, 0);
+  if (e->latency && e->latency->pending)
+  {
+    int onset = -1;
+    for (int i = 0; i < frames && onset < 0; i++)
+      if (abs(out[i * 2]) >= LATENCY_ONSET_S16 || abs(out[i * 2 + 1]) >= LATENCY_ONSET_S16)
+        onset = i;
+    latency_probe_block(e->latency, engine_now_us(), onset);
+  }
+  pthread_mutex_unlock(&e->lock);
+}
+
+void engine_render_f32(engine *e, float *out, int frames)
+{
+  pthread_mutex_lock(&e->lock);
+  tsf_render_float(e->tsf, out, frames, 0);
+  if (e->latency && e->latency->pending)
+  {
+    const float threshold = LATENCY_ONSET_S16 / 32768.0f;
+    int onset             = -1;
+    for (int i = 0; i < frames && onset < 0; i++)
+      if (fabsf(out[i * 2]) >= threshold || fabsf(out[i * 2 + 1]) >= threshold)
+        onset = i;
+    latency_probe_block(e->latency, engine_now_us(), onset);
+  }
+  pthread_mutex_unlock(&e->lock);
+}
+
+int engine_latency_start(engine *e, int buffer_frames)
+{
+  latency_probe *p = malloc(sizeof(latency_probe));
+  if (!p)
+    return -1;
+  latency_probe_init(p, e->cfg.sample_rate, buffer_frames);
+
+  pthread_mutex_lock(&e->lock);
+  latency_probe *old = e->latency;
+  e->latency         = p;
+  pthread_mutex_unlock(&e->lock);
+
+  free(old);
+  return 0;
+}
+
+void engine_latency_stop(engine *e)
+{
+  pthread_mutex_lock(&e->lock);
+  latency_probe *old = e->latency;
+  e->latency         = NULL;
+  pthread_mutex_unlock(&e->lock);
+
+  free(old);
+}
+
+int engine_latency_get(engine *e, engine_latency_report *out)
+{
+  // sorting happens outside the lock, on a copy, so the audio thread isn't held up
+  latency_probe *snap = malloc(sizeof(latency_probe));
+  if (!snap)
+    return -1;
+
+  pthread_mutex_lock(&e->lock);
+  int measuring = e->latency != NULL;
+  if (measuring)
+    *snap = *e->latency;
+  pthread_mutex_unlock(&e->lock);
+
+  if (measuring)
+    latency_probe_report(snap, out);
+  free(snap);
+  return measuring ? 0 : -1;
+}
+
+int engine_sample_rate(const engine *e)
+{
+  return e->cfg.sample_rate;
+}
+
+int engine_preset_count(engine *e)
+{
+  return tsf_get_presetcount(e->tsf);
+}
+
+void engine_set_preset(engine *e, int channel, int preset_index)
+{
+  // paging in reads the file while rendering goes on, only the stream thread waits for it
+  pthread_mutex_lock(&e->stream_lock);
+  if (!tsf_load_preset_samples(e->tsf, preset_index))
+    fprintf(stderr, "Could not load samples for preset %d\n", preset_index);
+  pthread_mutex_unlock(&e->stream_lock);
+
+  pthread_mutex_lock(&e->lock);
+  tsf_channel_set_presetindex(e->tsf, channel, preset_index);
+  pthread_mutex_unlock(&e->lock);
+}
+
+int engine_active_voices(engine *e)
+{
+  pthread_mutex_lock(&e->lock);
+  int count = tsf_active_voice_count(e->tsf);
+  pthread_mutex_unlock(&e->lock);
+  return count;
+}
+
+void engine_get_stats(engine *e, engine_stats *out)
+{
+  struct tsf_stats st;
+  pthread_mutex_lock(&e->lock);
+  tsf_get_stats(e->tsf, &st);
+  pthread_mutex_unlock(&e->lock);
+
+  out->active_voices    = st.activeVoices;
+  out->releasing_voices = st.releasingVoices;
+  out->peak_voices      = st.peakVoices;
+  out->stolen_voices    = st.stolenVoices;
+  out->refused_voices   = st.refusedVoices;
+
+  // microseconds of audio per rendered frame
+  double frame_us = 1e6 / e->cfg.sample_rate;
+  out->load       = st.renderFrames ? (float)(st.callTicks * st.renderCalls / (st.renderFrames * frame_us)) : 0.0f;
+  out->peak_load  = st.renderFrames ? (float)(st.maxCallTicks / ((double)st.renderFrames / st.renderCalls * frame_us)) : 0.0f;
+  out->voice_load = (float)(st.voiceTicks / frame_us);
+}
+
+uint64_t engine_now_us()
+{
+#ifdef __vita__
+  return sceKernelGetProcessTimeWide();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void engine_sleep_us(uint64_t us)
+{
+#ifdef __vita__
+  sceKernelDelayThread((SceUInt)us);
+#else
+  struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+  while (nanosleep(&ts, &ts))
+    ;
+#endif
+}
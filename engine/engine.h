@@ -0,0 +1,161 @@
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  enum MidiMessageType
+  {
+    MIDI_NOTE_OFF         = 0x80,
+    MIDI_NOTE_ON          = 0x90,
+    MIDI_KEY_PRESSURE     = 0xA0,
+    MIDI_CONTROL_CHANGE   = 0xB0,
+    MIDI_PROGRAM_CHANGE   = 0xC0,
+    MIDI_CHANNEL_PRESSURE = 0xD0,
+    MIDI_PITCH_BEND       = 0xE0,
+    MIDI_SET_TEMPO        = 0x51
+  };
+
+  // One decoded channel message
+  typedef struct
+  {
+    uint8_t type; // MidiMessageType, channel nibble stripped
+    uint8_t channel;
+    uint8_t data1;
+    uint8_t data2;
+  } engine_event;
+
+  // Event with the time it arrived (or was recorded) in microseconds
+  typedef struct
+  {
+    uint64_t time_us;
+    engine_event ev;
+  } engine_timed_event;
+
+  typedef struct
+  {
+    const char *font_path;
+    const char *font_cache; // compiled font to load instead of font_path unless it came from another file, rewritten then (NULL = off)
+    int sample_rate;
+    int channels;   // number of midi channels to set up (channel n plays bank n, preset 0)
+    float gain_db;
+    int max_voices;     // voices allocated up front, after that notes steal and events never allocate (0 = grow as needed)
+    int lazy_samples;   // leave samples in the file until a channel selects their preset
+    int stream_head_ms; // keep only this much of each sample in memory and stream the rest (implies lazy_samples), 0 = off
+  } engine_config;
+
+  typedef struct engine engine;
+
+  // Called after an event was applied to the synth, outside of the engine lock
+  typedef void (*engine_event_cb)(void *user, const engine_event *ev);
+
+  void engine_config_defaults(engine_config *cfg);
+
+  // Loads the soundfont and sets up channels, returns NULL on failure
+  engine *engine_create(const engine_config *cfg);
+  void engine_destroy(engine *e);
+
+  void engine_set_event_callback(engine *e, engine_event_cb cb, void *user);
+
+  // Decodes usb-midi 4-byte event packets (cable/cin, status, data1, data2).
+  // Returns number of events written to out.
+  int engine_decode_usb(const uint8_t *buf, int len, engine_event *out, int max);
+
+  // Decodes a single raw midi channel message (status byte first).
+  // Returns 1 if out was filled, 0 for anything that isn't a channel message.
+  int engine_decode_midi(const uint8_t *msg, int len, engine_event *out);
+
+  // Applies an event to the synth. Thread safe against rendering.
+  void engine_dispatch(engine *e, const engine_event *ev);
+
+  // Applies input events in order, recording them first while a capture is running.
+  void engine_feed(engine *e, const engine_timed_event *evs, int count);
+
+  // Records every fed event with its timestamp into a capture file (see input.h).
+  // Returns 0 on success. Starting a new capture closes the previous one.
+  int engine_capture_start(engine *e, const char *path);
+  void engine_capture_stop(engine *e);
+  int engine_capturing(engine *e);
+
+  // Renders interleaved stereo frames. Thread safe against dispatch.
+  void engine_render_s16(engine *e, int16_t *out, int frames);
+  void engine_render_f32(engine *e, float *out, int frames);
+
+  int engine_sample_rate(const engine *e);
+  int engine_preset_count(engine *e);
+  // With lazy_samples, reads the preset's samples in first without holding up rendering
+  void engine_set_preset(engine *e, int channel, int preset_index);
+  int engine_active_voices(engine *e);
+
+  // Synth load and voice counts; the peaks, counts and loads cover the time since the previous call
+  typedef struct
+  {
+    int active_voices;
+    int releasing_voices;
+    int peak_voices;
+    int stolen_voices;  // killed in their release to make room for new notes
+    int refused_voices; // not started, no voice was free to steal
+    float load;         // time spent rendering / audio time rendered, 1.0 is the whole realtime budget
+    float peak_load;    // the same for the slowest block
+    float voice_load;   // what a single playing voice costs on average, in the same unit
+  } engine_stats;
+
+  void engine_get_stats(engine *e, engine_stats *out);
+
+  // Distribution of one latency stage, in milliseconds
+  typedef struct
+  {
+    double min, mean, p50, p95, p99, max;
+  } engine_latency_dist;
+
+  typedef struct
+  {
+    int count;                  // notes measured
+    int skipped;                // notes that hit a sounding synth (or never became audible)
+    engine_latency_dist queue;  // input timestamp -> applied to the synth
+    engine_latency_dist render; // applied -> end of the render call holding its first audible frame
+    engine_latency_dist buffer; // that frame's offset in the block + audio queued ahead in the device
+    engine_latency_dist total;
+  } engine_latency_report;
+
+  // Measures note-on to first audible output frame for notes fed while the synth is silent.
+  // buffer_frames is how much audio the output device holds ahead of a freshly rendered block.
+  int engine_latency_start(engine *e, int buffer_frames);
+  void engine_latency_stop(engine *e);
+  // Returns -1 when not measuring
+  int engine_latency_get(engine *e, engine_latency_report *out);
+  void engine_latency_print(const engine_latency_report *r, FILE *f);
+
+  // Monotonic clock used for event timestamps
+  uint64_t engine_now_us();
+  void engine_sleep_us(uint64_t us);
+
+  // Audio output the host tools render into
+  struct engine_sink
+  {
+    // Custom data given to the functions as the first parameter
+    void *data;
+
+    // Writes 'frames' interleaved stereo frames, returns number written
+    int (*write)(void *data, const int16_t *frames, int count);
+
+    // Flushes and releases the sink
+    void (*close)(void *data);
+  };
+
+  // Discards everything (pure synth cost when profiling)
+  int engine_sink_null(struct engine_sink *sink);
+
+  // Writes a 16-bit stereo wav file, returns 0 on success
+  int engine_sink_wav(struct engine_sink *sink, const char *path, int sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ENGINE_H__
@@ -0,0 +1,62 @@
+// SoundFont compiler: loads a .sf2 and writes it as a compiled font (.tsfc) that tsf_load_compiled
+// (or engine_config.font_cache) opens with a single read, then reports both load times.
+// The output only loads in builds with the same tsf configuration as this tool, i.e. the engine's.
+
+#include <tsf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static double _now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3 || !strcmp(argv[1], "-h"))
+  {
+    fprintf(stderr, "usage: %s font.sf2 out.tsfc\n", argv[0]);
+    return argc == 2 ? 0 : 1;
+  }
+
+  double t0 = _now();
+  tsf *f    = tsf_load_filename(argv[1]);
+  if (!f)
+  {
+    fprintf(stderr, "could not load soundfont %s\n", argv[1]);
+    return 1;
+  }
+  double t1 = _now();
+
+  // stamped with the soundfont's size and time like the engine's cache, so it can stand in for one
+  struct stat st;
+  if (stat(argv[1], &st) || !tsf_save_compiled(f, argv[2], st.st_size, st.st_mtime))
+  {
+    fprintf(stderr, "could not write %s\n", argv[2]);
+    tsf_close(f);
+    return 1;
+  }
+  int presets = tsf_get_presetcount(f);
+  tsf_close(f);
+
+  double t2 = _now();
+  f         = tsf_load_compiled(argv[2]);
+  double t3 = _now();
+  if (!f)
+  {
+    fprintf(stderr, "could not load %s back\n", argv[2]);
+    return 1;
+  }
+  tsf_close(f);
+
+  printf("presets:       %d\n", presets);
+  printf("load sf2:      %.2f ms\n", (t1 - t0) * 1000);
+  printf("load compiled: %.2f ms\n", (t3 - t2) * 1000);
+  return 0;
+}
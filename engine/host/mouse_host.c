@@ -0,0 +1,422 @@
+// Headless driver for the synth engine: plays a deterministic note pattern,
+// a capture file or a live midi pipe into a null or wav sink, reporting render cost.
+
+#include <engine.h>
+#include <input.h>
+#include <topology.h>
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef MOUSE_DEFAULT_FONT
+#define MOUSE_DEFAULT_FONT "data/florestan-subset.sf2"
+#endif
+
+typedef struct
+{
+  engine *e;
+  struct engine_input in;
+  volatile int done;
+} input_thread;
+
+typedef struct
+{
+  double render_time;
+  double worst_block;
+  long blocks;
+  long late_blocks;
+  int peak_voices;
+} render_stats;
+
+static void _usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -f font.sf2   soundfont (default %s)\n"
+          "  -o out.wav    write rendered audio (default: null sink)\n"
+          "  -s seconds    length of the pattern / realtime run (default 10)\n"
+          "  -n notes      notes per chord (default 8)\n"
+          "  -c channels   midi channels to spread chords over (default 1)\n"
+          "  -b frames     frames per render call (default 4096, like the app)\n"
+          "  -r rate       output sample rate (default 44100)\n"
+          "  -i input      play a capture file, or pipe:PATH for a raw midi stream (pipe:- is stdin)\n"
+          "  -R            realtime: pace rendering like an audio device and read input on its own thread\n"
+          "  -w file.mcap  capture every event fed to the engine\n"
+          "  -L            measure note-on to audio latency (implies -R, isolated test notes without -i)\n"
+          "  -t spec       thread topology, e.g. audio=1:rt,midi=2:high\n"
+          "  -P            page samples in per preset instead of loading the whole font\n"
+          "  -S ms         keep ms of each sample in memory and stream the rest from disk\n"
+          "  -v voices     voices allocated up front, 0 grows them as needed (default 128)\n",
+          argv0, MOUSE_DEFAULT_FONT);
+}
+
+static void _render_block(engine *e, int16_t *buf, int frames, struct engine_sink *sink, render_stats *st, double budget)
+{
+  uint64_t t0 = engine_now_us();
+  engine_render_s16(e, buf, frames);
+  double dt = (engine_now_us() - t0) / 1e6;
+
+  st->render_time += dt;
+  if (dt > st->worst_block)
+    st->worst_block = dt;
+  if (budget > 0 && dt > budget)
+    st->late_blocks++;
+  st->blocks++;
+
+  int voices = engine_active_voices(e);
+  if (voices > st->peak_voices)
+    st->peak_voices = voices;
+
+  sink->write(sink->data, buf, frames);
+}
+
+static void _feed_chord(engine *e, int type, int chord, int notes, int channels, uint64_t time_us)
+{
+  for (int i = 0; i < notes; i++)
+  {
+    engine_timed_event ev = {time_us, {(uint8_t)type, (uint8_t)(i % channels), (uint8_t)(36 + (chord * 5 + i * 7) % 60), 0}};
+    if (type == MIDI_NOTE_ON)
+      ev.ev.data2 = (uint8_t)(64 + (i * 13) % 63);
+    engine_feed(e, &ev, 1);
+  }
+}
+
+// a chord every half second, held for 3/8 of a second, walking up the keyboard
+static int64_t _run_pattern(engine *e, int rate, int block, double seconds, int notes, int channels, int16_t *buf,
+                            struct engine_sink *sink, render_stats *st)
+{
+  const int chord_every = rate / 2;
+  const int chord_hold  = rate * 3 / 8;
+  int64_t total         = (int64_t)(seconds * rate);
+  int64_t pos           = 0;
+  int chord = 0, held = 0;
+
+  while (pos < total)
+  {
+    int64_t phase = pos % chord_every;
+    int frames    = block;
+    // split blocks on pattern edges so events land where they belong
+    if (phase < chord_hold && phase + frames > chord_hold)
+      frames = (int)(chord_hold - phase);
+    else if (phase + frames > chord_every)
+      frames = (int)(chord_every - phase);
+    if (pos + frames > total)
+      frames = (int)(total - pos);
+
+    uint64_t time_us = (uint64_t)(pos * 1000000 / rate);
+    if (phase == 0)
+    {
+      _feed_chord(e, MIDI_NOTE_ON, chord, notes, channels, time_us);
+      held = 1;
+    }
+    else if (phase == chord_hold && held)
+    {
+      _feed_chord(e, MIDI_NOTE_OFF, chord, notes, channels, time_us);
+      held = 0;
+      chord++;
+    }
+
+    _render_block(e, buf, frames, sink, st, 0);
+    pos += frames;
+  }
+  return total;
+}
+
+// deterministic playback of a capture: events land on the frame matching their timestamp
+static int64_t _run_offline(engine *e, struct engine_input *in, int rate, int block, int16_t *buf, struct engine_sink *sink,
+                            render_stats *st)
+{
+  engine_timed_event evs[64];
+  int64_t pos = 0;
+  int n;
+
+  while ((n = in->read(in->data, evs, 64)) != ENGINE_INPUT_END)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      int64_t at = (int64_t)((evs[i].time_us * rate + 500000) / 1000000);
+      while (pos < at)
+      {
+        int frames = (int)(at - pos < block ? at - pos : block);
+        _render_block(e, buf, frames, sink, st, 0);
+        pos += frames;
+      }
+      engine_feed(e, &evs[i], 1);
+    }
+  }
+
+  // let releases ring out
+  for (int64_t tail_end = pos + rate * 2; pos < tail_end && engine_active_voices(e); pos += block)
+    _render_block(e, buf, block, sink, st, 0);
+  return pos;
+}
+
+typedef struct
+{
+  uint64_t next_us;
+  int note_on;
+  int key;
+} probe_notes;
+
+// isolated notes for latency runs: a short note every second, so each one starts from silence
+static int _probe_read(void *data, engine_timed_event *out, int max)
+{
+  probe_notes *p = data;
+  uint64_t now   = engine_now_us();
+  if (!p->next_us)
+    p->next_us = now + 100000;
+  if (p->next_us > now + ENGINE_INPUT_WAIT_US)
+  {
+    engine_sleep_us(ENGINE_INPUT_WAIT_US);
+    return 0;
+  }
+  if (p->next_us > now)
+    engine_sleep_us(p->next_us - now);
+
+  out[0].time_us    = engine_now_us();
+  out[0].ev.type    = p->note_on ? MIDI_NOTE_OFF : MIDI_NOTE_ON;
+  out[0].ev.channel = 0;
+  out[0].ev.data1   = (uint8_t)(48 + p->key % 24);
+  out[0].ev.data2   = p->note_on ? 0 : 100;
+
+  // a little jitter so arrivals don't lock to the render period
+  p->next_us += p->note_on ? 900000 + (p->key * 7919 % 100) * 100 : 100000;
+  if (p->note_on)
+    p->key++;
+  p->note_on = !p->note_on;
+  (void)max;
+  return 1;
+}
+
+static void _probe_close(void *data)
+{
+  (void)data;
+}
+
+static void *_input_thread(void *data)
+{
+  input_thread *t = data;
+  engine_timed_event evs[16];
+  int n;
+
+  topology_apply(TOPOLOGY_MIDI);
+  while (!t->done && (n = t->in.read(t->in.data, evs, 16)) != ENGINE_INPUT_END)
+  {
+    // the render loop may have finished while this was waiting
+    if (t->done)
+      break;
+    engine_feed(t->e, evs, n);
+  }
+  t->done = 1;
+  return NULL;
+}
+
+// renders one block per block period of wall clock, like an audio callback would be called
+static int64_t _run_realtime(engine *e, input_thread *t, int rate, int block, double seconds, int16_t *buf,
+                             struct engine_sink *sink, render_stats *st)
+{
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, _input_thread, t))
+    return 0;
+
+  topology_apply(TOPOLOGY_AUDIO);
+
+  double period    = (double)block / rate;
+  uint64_t start   = engine_now_us();
+  int64_t pos      = 0;
+  int64_t total    = (int64_t)(seconds * rate);
+  while (pos < total && !(t->done && !engine_active_voices(e)))
+  {
+    _render_block(e, buf, block, sink, st, period);
+    pos += block;
+
+    uint64_t due = start + (uint64_t)(pos * 1000000 / rate);
+    uint64_t now = engine_now_us();
+    if (due > now)
+      engine_sleep_us(due - now);
+  }
+
+  // reads return within ENGINE_INPUT_WAIT_US, so the thread is gone before the engine is
+  t->done = 1;
+  pthread_join(thread, NULL);
+  return pos;
+}
+
+int main(int argc, char *argv[])
+{
+  engine_config cfg;
+  engine_config_defaults(&cfg);
+  cfg.font_path = MOUSE_DEFAULT_FONT;
+
+  const char *out_path     = NULL;
+  const char *input_path   = NULL;
+  const char *capture_path = NULL;
+  double seconds           = 10.0;
+  int notes                = 8;
+  int channels             = 1;
+  int block                = 4096;
+  int realtime             = 0;
+  int latency              = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:o:s:n:c:b:r:i:RLw:t:PS:v:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        cfg.font_path = optarg;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 's':
+        seconds = atof(optarg);
+        break;
+      case 'n':
+        notes = atoi(optarg);
+        break;
+      case 'c':
+        channels = atoi(optarg);
+        break;
+      case 'b':
+        block = atoi(optarg);
+        break;
+      case 'r':
+        cfg.sample_rate = atoi(optarg);
+        break;
+      case 'i':
+        input_path = optarg;
+        break;
+      case 'R':
+        realtime = 1;
+        break;
+      case 'L':
+        realtime = latency = 1;
+        break;
+      case 'w':
+        capture_path = optarg;
+        break;
+      case 'P':
+        cfg.lazy_samples = 1;
+        break;
+      case 'S':
+        cfg.stream_head_ms = atoi(optarg);
+        break;
+      case 'v':
+        cfg.max_voices = atoi(optarg);
+        break;
+      case 't':
+        if (topology_parse(optarg) < 0)
+        {
+          fprintf(stderr, "bad topology spec: %s\n", optarg);
+          return 1;
+        }
+        break;
+      default:
+        _usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (block <= 0 || notes <= 0 || channels <= 0 || seconds <= 0 || (realtime && !latency && !input_path))
+  {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  engine *e = engine_create(&cfg);
+  if (!e)
+    return 1;
+
+  input_thread t;
+  probe_notes probe;
+  memset(&t, 0, sizeof(t));
+  memset(&probe, 0, sizeof(probe));
+  t.e = e;
+  if (!input_path)
+  {
+    t.in.data  = &probe;
+    t.in.read  = _probe_read;
+    t.in.close = _probe_close;
+  }
+  else
+  {
+    int res = strncmp(input_path, "pipe:", 5) ? engine_input_replay(&t.in, input_path, realtime)
+                                              : engine_input_pipe(&t.in, input_path + 5);
+    if (res)
+    {
+      fprintf(stderr, "could not open input %s\n", input_path);
+      engine_destroy(e);
+      return 1;
+    }
+  }
+
+  if (capture_path && engine_capture_start(e, capture_path))
+  {
+    fprintf(stderr, "could not open %s\n", capture_path);
+    t.in.close(t.in.data);
+    engine_destroy(e);
+    return 1;
+  }
+
+  struct engine_sink sink;
+  if (out_path ? engine_sink_wav(&sink, out_path, cfg.sample_rate) : engine_sink_null(&sink))
+  {
+    fprintf(stderr, "could not open %s\n", out_path);
+    t.in.close(t.in.data);
+    engine_destroy(e);
+    return 1;
+  }
+
+  int16_t *buf = malloc(sizeof(int16_t) * 2 * block);
+  if (!buf)
+    return 1;
+
+  // the rendered block plays out while the next one renders, like a double buffered device
+  if (latency)
+    engine_latency_start(e, block);
+
+  render_stats st;
+  memset(&st, 0, sizeof(st));
+  int64_t total;
+  if (realtime)
+    total = _run_realtime(e, &t, cfg.sample_rate, block, seconds, buf, &sink, &st);
+  else
+  {
+    topology_apply(TOPOLOGY_AUDIO);
+    if (input_path)
+      total = _run_offline(e, &t.in, cfg.sample_rate, block, buf, &sink, &st);
+    else
+      total = _run_pattern(e, cfg.sample_rate, block, seconds, notes, channels, buf, &sink, &st);
+  }
+
+  sink.close(sink.data);
+  engine_capture_stop(e);
+
+  double audio_time = (double)total / cfg.sample_rate;
+  printf("rendered:      %.2f s of audio in %ld blocks\n", audio_time, st.blocks);
+  printf("render time:   %.3f s\n", st.render_time);
+  printf("realtime:      %.1fx\n", st.render_time > 0 ? audio_time / st.render_time : 0.0);
+  printf("avg block:     %.1f us\n", st.blocks ? st.render_time / st.blocks * 1e6 : 0.0);
+  printf("worst block:   %.1f us\n", st.worst_block * 1e6);
+  printf("peak voices:   %d\n", st.peak_voices);
+  if (realtime)
+    printf("late blocks:   %ld\n", st.late_blocks);
+
+  engine_stats es;
+  engine_get_stats(e, &es);
+  printf("synth load:    %.1f%% avg, %.1f%% peak, %.2f%% per voice\n", es.load * 100, es.peak_load * 100,
+         es.voice_load * 100);
+  printf("stolen voices: %d (%d refused)\n", es.stolen_voices, es.refused_voices);
+
+  engine_latency_report report;
+  if (!engine_latency_get(e, &report))
+    engine_latency_print(&report, stdout);
+
+  free(buf);
+  t.in.close(t.in.data);
+  engine_destroy(e);
+  return 0;
+}
@@ -0,0 +1,225 @@
+// Offline Standard MIDI File renderer: plays a .mid through tsf as fast as
+// the cpu allows, optionally writing a wav, and reports the realtime factor.
+
+#include <engine.h>
+#include <smf.h>
+#include <topology.h>
+
+#include <tsf.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef MOUSE_DEFAULT_FONT
+#define MOUSE_DEFAULT_FONT "data/florestan-subset.sf2"
+#endif
+
+static double _now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [options] song.mid\n"
+          "  -f font.sf2   soundfont or compiled font (default %s)\n"
+          "  -o out.wav    write rendered audio (default: render only)\n"
+          "  -r rate       output sample rate (default 44100)\n"
+          "  -b frames     frames per render call (default 512)\n"
+          "  -g gain       global gain in dB (default 0)\n"
+          "  -l tail       max seconds rendered after the last event (default 2)\n"
+          "  -n passes     render the song n times and report the best pass (default 1)\n"
+          "  -t spec       thread topology for the render thread, e.g. audio=1:rt\n",
+          argv0, MOUSE_DEFAULT_FONT);
+}
+
+static void _reset_channels(tsf *f)
+{
+  tsf_reset(f);
+  for (int ch = 0; ch < 16; ch++)
+    tsf_channel_set_presetnumber(f, ch, 0, ch == 9);
+}
+
+static void _dispatch(tsf *f, const engine_event *ev)
+{
+  switch (ev->type)
+  {
+    case MIDI_NOTE_ON:
+      tsf_channel_note_on(f, ev->channel, ev->data1, ev->data2 / 127.0f);
+      break;
+    case MIDI_NOTE_OFF:
+      tsf_channel_note_off(f, ev->channel, ev->data1);
+      break;
+    case MIDI_PROGRAM_CHANGE:
+      tsf_channel_set_presetnumber(f, ev->channel, ev->data1, ev->channel == 9);
+      break;
+    case MIDI_CONTROL_CHANGE:
+      tsf_channel_midi_control(f, ev->channel, ev->data1, ev->data2);
+      break;
+    case MIDI_PITCH_BEND:
+      tsf_channel_set_pitchwheel(f, ev->channel, ev->data2 << 7 | ev->data1);
+      break;
+    default:
+      break;
+  }
+}
+
+// Renders the whole song once, returns the number of frames produced
+static int64_t _render(tsf *f, const smf *song, int rate, int block, double tail, int16_t *buf, struct engine_sink *sink)
+{
+  int64_t pos = 0, tail_end;
+  int next    = 0;
+
+  _reset_channels(f);
+
+  while (next < song->count)
+  {
+    int64_t at = (int64_t)(song->events[next].time * rate + 0.5);
+    while (pos < at)
+    {
+      int frames = (int)(at - pos < block ? at - pos : block);
+      tsf_render_short(f, buf, frames, 0);
+      if (sink)
+        sink->write(sink->data, buf, frames);
+      pos += frames;
+    }
+    for (; next < song->count && (int64_t)(song->events[next].time * rate + 0.5) <= pos; next++)
+      _dispatch(f, &song->events[next].ev);
+  }
+
+  // let releases ring out, but don't render silence forever
+  tail_end = pos + (int64_t)(tail * rate);
+  while (pos < tail_end && tsf_active_voice_count(f))
+  {
+    int frames = (int)(tail_end - pos < block ? tail_end - pos : block);
+    tsf_render_short(f, buf, frames, 0);
+    if (sink)
+      sink->write(sink->data, buf, frames);
+    pos += frames;
+  }
+  return pos;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *font_path = MOUSE_DEFAULT_FONT;
+  const char *out_path  = NULL;
+  int rate              = 44100;
+  int block             = 512;
+  float gain            = 0.0f;
+  double tail           = 2.0;
+  int passes            = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:o:r:b:g:l:n:t:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        font_path = optarg;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'b':
+        block = atoi(optarg);
+        break;
+      case 'g':
+        gain = (float)atof(optarg);
+        break;
+      case 'l':
+        tail = atof(optarg);
+        break;
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      case 't':
+        if (topology_parse(optarg) < 0)
+        {
+          fprintf(stderr, "bad topology spec: %s\n", optarg);
+          return 1;
+        }
+        break;
+      default:
+        _usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || rate <= 0 || block <= 0 || passes <= 0)
+  {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  topology_apply(TOPOLOGY_AUDIO);
+
+  double t0 = _now();
+  smf song;
+  int res = smf_load(&song, argv[optind]);
+  if (res < 0)
+  {
+    fprintf(stderr, res == -1 ? "could not read %s\n" : "%s is not a midi file\n", argv[optind]);
+    return 1;
+  }
+  double t1 = _now();
+
+  // compiled fonts (see fontc) load as well
+  tsf *f = tsf_load_compiled(font_path);
+  if (!f)
+    f = tsf_load_filename(font_path);
+  if (!f)
+  {
+    fprintf(stderr, "could not load soundfont %s\n", font_path);
+    smf_free(&song);
+    return 1;
+  }
+  tsf_set_output(f, TSF_STEREO_INTERLEAVED, rate, gain);
+  double t2 = _now();
+
+  int16_t *buf = malloc(sizeof(int16_t) * 2 * block);
+  if (!buf)
+    return 1;
+
+  double best = 0, sum = 0;
+  int64_t frames = 0;
+  for (int i = 0; i < passes; i++)
+  {
+    struct engine_sink sink;
+    int write = (i == 0 && out_path);
+    if (write && engine_sink_wav(&sink, out_path, rate))
+    {
+      fprintf(stderr, "could not open %s\n", out_path);
+      return 1;
+    }
+
+    double start = _now();
+    frames       = _render(f, &song, rate, block, tail, buf, write ? &sink : NULL);
+    double dt    = _now() - start;
+
+    if (write)
+      sink.close(sink.data);
+    sum += dt;
+    if (!i || dt < best)
+      best = dt;
+  }
+
+  double audio = (double)frames / rate;
+  printf("song:          %d events, %d tracks, %.2f s\n", song.count, song.tracks, song.length);
+  printf("load:          midi %.1f ms, font %.1f ms\n", (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+  printf("rendered:      %.2f s of audio, %d pass(es)\n", audio, passes);
+  printf("render time:   best %.3f s, avg %.3f s\n", best, sum / passes);
+  printf("realtime:      %.1fx\n", best > 0 ? audio / best : 0.0);
+
+  free(buf);
+  tsf_close(f);
+  smf_free(&song);
+  return 0;
+}
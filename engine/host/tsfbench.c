@@ -0,0 +1,250 @@
+// Synth benchmarks writing CSV, to track tsf performance across changes:
+//   render   cost per output frame as polyphony goes from 1 to 256 voices, plain and with
+//            filter/LFO modulation forced on every region, for each output mode
+//   note     cost of a note-on and of a note-off with that many voices already playing
+//   load     SoundFont load time for every -f font, parsed and compiled (see fontc)
+// Builds its own tsf with the engine's options so it can reach into the regions.
+
+#define TSF_SAMPLES_SHORT
+#define TSF_IMPLEMENTATION
+#include "tsf.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef MOUSE_DEFAULT_FONT
+#define MOUSE_DEFAULT_FONT "data/florestan-subset.sf2"
+#endif
+
+#define BENCH_RATE 44100
+#define BENCH_BLOCK 512
+#define BENCH_MAX_FONTS 16
+#define BENCH_NOTE_REPEATS 200
+
+static const int g_voice_steps[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+#define VOICE_STEPS (int)(sizeof(g_voice_steps) / sizeof(g_voice_steps[0]))
+
+static double _now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -f font.sf2   font to load, repeat for fonts of different sizes; the first one is played\n"
+          "                (default %s)\n"
+          "  -o out.csv    write the results there instead of stdout\n"
+          "  -p preset     preset index played by the render and note benchmarks (default 0)\n"
+          "  -s seconds    audio rendered per measurement (default 1)\n",
+          argv0, MOUSE_DEFAULT_FONT);
+}
+
+// Modulates filter cutoff, pitch and volume on every region so each voice takes the dynamic paths
+static void _force_modulation(tsf *f)
+{
+  for (int p = 0; p < f->presetNum; p++)
+  {
+    struct tsf_preset *preset = &f->presets[p];
+    for (int i = 0; i < preset->regionNum; i++)
+    {
+      struct tsf_region *r = &preset->regions[i];
+      r->initialFilterFc  = 9000;
+      r->modLfoToFilterFc = 1200;
+      r->modLfoToPitch    = 20;
+      r->vibLfoToPitch    = 15;
+      r->modLfoToVolume   = 30;
+    }
+  }
+}
+
+// Kills everything and starts notes until at least 'voices' voices play
+static void _start_voices(tsf *f, int preset, int voices)
+{
+  while (f->activeVoiceNum)
+    tsf_voice_kill(f, &f->voices[f->voiceSlots[0]]);
+  for (int n = 0; tsf_active_voice_count(f) < voices && n < 128 * 8; n++)
+    tsf_note_on(f, preset, 21 + n % 88, 0.5f + (n / 88 % 4) * 0.1f);
+}
+
+static void _bench_render(FILE *out, tsf *f, const char *modulation, int preset, double seconds)
+{
+  static float fbuf[BENCH_BLOCK * 2];
+  static short sbuf[BENCH_BLOCK * 2];
+  const struct
+  {
+    const char *name;
+    enum TSFOutputMode mode;
+    int is_short;
+  } outputs[] = {{"float_interleaved", TSF_STEREO_INTERLEAVED, 0},
+                 {"float_unweaved", TSF_STEREO_UNWEAVED, 0},
+                 {"float_mono", TSF_MONO, 0},
+                 {"short_interleaved", TSF_STEREO_INTERLEAVED, 1}};
+  int blocks = (int)(seconds * BENCH_RATE / BENCH_BLOCK);
+  if (blocks < 1)
+    blocks = 1;
+
+  for (int o = 0; o < (int)(sizeof(outputs) / sizeof(outputs[0])); o++)
+  {
+    tsf_set_output(f, outputs[o].mode, BENCH_RATE, 0);
+    for (int s = 0; s < VOICE_STEPS; s++)
+    {
+      _start_voices(f, preset, g_voice_steps[s]);
+
+      // voices that end during the run count for the time they played
+      double time = 0, voice_frames = 0;
+      for (int b = 0; b < blocks; b++)
+      {
+        voice_frames += (double)tsf_active_voice_count(f) * BENCH_BLOCK;
+        double start = _now();
+        if (outputs[o].is_short)
+          tsf_render_short(f, sbuf, BENCH_BLOCK, 0);
+        else
+          tsf_render_float(f, fbuf, BENCH_BLOCK, 0);
+        time += _now() - start;
+      }
+      double frames = (double)blocks * BENCH_BLOCK;
+      fprintf(out, "render,%s,%s,%d,%.2f,ns_per_frame\n", modulation, outputs[o].name, g_voice_steps[s],
+              time * 1e9 / frames);
+      fprintf(out, "render,%s,%s,%d,%.3f,ns_per_voice_frame\n", modulation, outputs[o].name, g_voice_steps[s],
+              voice_frames ? time * 1e9 / voice_frames : 0.0);
+    }
+  }
+}
+
+static void _bench_notes(FILE *out, tsf *f, int preset)
+{
+  tsf_set_output(f, TSF_STEREO_INTERLEAVED, BENCH_RATE, 0);
+  for (int s = 0; s < VOICE_STEPS; s++)
+  {
+    double on = 0, off = 0;
+    for (int r = 0; r < BENCH_NOTE_REPEATS; r++)
+    {
+      _start_voices(f, preset, g_voice_steps[s]);
+      int key = 21 + r % 88;
+
+      double start = _now();
+      tsf_note_on(f, preset, key, 0.8f);
+      double mid = _now();
+      tsf_note_off(f, preset, key);
+      double end = _now();
+      on += mid - start;
+      off += end - mid;
+    }
+    fprintf(out, "note_on,,,%d,%.3f,us\n", g_voice_steps[s], on * 1e6 / BENCH_NOTE_REPEATS);
+    fprintf(out, "note_off,,,%d,%.3f,us\n", g_voice_steps[s], off * 1e6 / BENCH_NOTE_REPEATS);
+  }
+}
+
+// Best of a few loads, in ms, or -1 if the font doesn't load
+static double _time_load(const char *path, int compiled)
+{
+  double best = -1;
+  for (int i = 0; i < 5; i++)
+  {
+    double start = _now();
+    tsf *f       = compiled ? tsf_load_compiled(path) : tsf_load_filename(path);
+    double t     = (_now() - start) * 1000;
+    if (!f)
+      return -1;
+    tsf_close(f);
+    if (best < 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+static void _bench_load(FILE *out, const char *path)
+{
+  const char *cache = "tsfbench.tsfc";
+  fprintf(out, "load,%s,sf2,,%.3f,ms\n", path, _time_load(path, 0));
+
+  tsf *f = tsf_load_filename(path);
+  if (f && tsf_save_compiled(f, cache, 0, 0))
+  {
+    fprintf(out, "load,%s,compiled,,%.3f,ms\n", path, _time_load(cache, 1));
+    remove(cache);
+  }
+  tsf_close(f);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *fonts[BENCH_MAX_FONTS];
+  int font_count       = 0;
+  const char *out_path = NULL;
+  int preset           = 0;
+  double seconds       = 1.0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:o:p:s:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        if (font_count < BENCH_MAX_FONTS)
+          fonts[font_count++] = optarg;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 'p':
+        preset = atoi(optarg);
+        break;
+      case 's':
+        seconds = atof(optarg);
+        break;
+      default:
+        _usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!font_count)
+    fonts[font_count++] = MOUSE_DEFAULT_FONT;
+  if (seconds <= 0)
+  {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  tsf *plain = tsf_load_filename(fonts[0]), *modulated = tsf_load_filename(fonts[0]);
+  if (!plain || !modulated)
+  {
+    fprintf(stderr, "could not load soundfont %s\n", fonts[0]);
+    return 1;
+  }
+  if (preset < 0 || preset >= tsf_get_presetcount(plain))
+  {
+    fprintf(stderr, "no preset %d in %s\n", preset, fonts[0]);
+    return 1;
+  }
+  _force_modulation(modulated);
+  // room for every step without growing while measuring
+  tsf_set_max_voices(plain, 512);
+  tsf_set_max_voices(modulated, 512);
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out)
+  {
+    fprintf(stderr, "could not open %s\n", out_path);
+    return 1;
+  }
+
+  fprintf(out, "bench,variant,output,voices,value,unit\n");
+  _bench_render(out, plain, "plain", preset, seconds);
+  _bench_render(out, modulated, "modulated", preset, seconds);
+  _bench_notes(out, plain, preset);
+  for (int i = 0; i < font_count; i++)
+    _bench_load(out, fonts[i]);
+
+  if (out != stdout)
+    fclose(out);
+  tsf_close(plain);
+  tsf_close(modulated);
+  return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ENGINE_INPUT_END -1
+// longest a read may block, so a thread reading an input can be stopped
+#define ENGINE_INPUT_WAIT_US 50000
+
+  // Where decoded midi events come from (usb, a capture file, a pipe)
+  struct engine_input
+  {
+    // Custom data given to the functions as the first parameter
+    void *data;
+
+    // Blocks until events are available (for up to ENGINE_INPUT_WAIT_US) and fills up to 'max' of them.
+    // Returns number of events (0 is fine, just call again) or ENGINE_INPUT_END.
+    int (*read)(void *data, engine_timed_event *out, int max);
+
+    // Releases the source
+    void (*close)(void *data);
+  };
+
+  // Capture files are a 8 byte header ("MCAP", version, 3 reserved bytes)
+  // followed by one record per event: uleb128 microseconds since the previous
+  // event, then status (type | channel), data1 and data2.
+#define ENGINE_CAPTURE_VERSION 1
+
+  typedef struct engine_capture engine_capture;
+
+  engine_capture *engine_capture_open(const char *path);
+  int engine_capture_write(engine_capture *cap, const engine_timed_event *evs, int count);
+  void engine_capture_close(engine_capture *cap);
+
+  // Plays back a capture file. With realtime set, read() sleeps to reproduce
+  // the recorded timing and stamps events with the current engine_now_us().
+  // Otherwise events come back immediately, stamped relative to the first one.
+  int engine_input_replay(struct engine_input *in, const char *path, int realtime);
+
+#ifdef __vita__
+  // libmouse usb-midi device, polls every 10ms while nothing is attached
+  int engine_input_usb(struct engine_input *in);
+#else
+  // Raw midi byte stream from a file descriptor path (fifo, tty, "-" for stdin)
+  int engine_input_pipe(struct engine_input *in, const char *path);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __INPUT_H__
@@ -0,0 +1,102 @@
+#include "input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct pipe_input
+{
+  int fd;
+  uint8_t status;
+  uint8_t data[2];
+  int have;
+  int in_sysex;
+  // bytes read but not parsed yet, when a read held more than 'max' events
+  uint8_t buf[256];
+  int pos, len;
+};
+
+static int _expected(uint8_t status)
+{
+  uint8_t type = status & 0xF0;
+  return (type == MIDI_PROGRAM_CHANGE || type == MIDI_CHANNEL_PRESSURE) ? 1 : 2;
+}
+
+static int _pipe_read(void *data, engine_timed_event *out, int max)
+{
+  struct pipe_input *p = data;
+
+  if (p->pos == p->len)
+  {
+    // wake up now and then so a reader thread can be stopped
+    struct pollfd pfd = {p->fd, POLLIN, 0};
+    int ready         = poll(&pfd, 1, ENGINE_INPUT_WAIT_US / 1000);
+    if (ready == 0 || (ready < 0 && errno == EINTR))
+      return 0;
+    ssize_t n = ready > 0 ? read(p->fd, p->buf, sizeof(p->buf)) : -1;
+    if (n < 0 && errno == EINTR)
+      return 0;
+    if (n <= 0)
+      return ENGINE_INPUT_END;
+    p->pos = 0;
+    p->len = (int)n;
+  }
+
+  uint64_t now = engine_now_us();
+  int count    = 0;
+  while (p->pos < p->len && count < max)
+  {
+    uint8_t b = p->buf[p->pos++];
+    if (b >= 0xF8)
+      continue; // realtime bytes may appear anywhere and don't touch running status
+    if (b & 0x80)
+    {
+      p->in_sysex = (b == 0xF0);
+      p->status   = b < 0xF0 ? b : 0;
+      p->have     = 0;
+      continue;
+    }
+    if (p->in_sysex || !p->status)
+      continue;
+
+    p->data[p->have++] = b;
+    if (p->have == _expected(p->status))
+    {
+      uint8_t msg[3] = {p->status, p->data[0], p->data[1]};
+      if (engine_decode_midi(msg, 1 + p->have, &out[count].ev))
+        out[count++].time_us = now;
+      p->have = 0;
+    }
+  }
+  return count;
+}
+
+static void _pipe_close(void *data)
+{
+  struct pipe_input *p = data;
+  if (p->fd != STDIN_FILENO)
+    close(p->fd);
+  free(p);
+}
+
+int engine_input_pipe(struct engine_input *in, const char *path)
+{
+  struct pipe_input *p = calloc(1, sizeof(struct pipe_input));
+  if (!p)
+    return -1;
+
+  p->fd = strcmp(path, "-") ? open(path, O_RDONLY) : STDIN_FILENO;
+  if (p->fd < 0)
+  {
+    free(p);
+    return -1;
+  }
+
+  in->data  = p;
+  in->read  = _pipe_read;
+  in->close = _pipe_close;
+  return 0;
+}
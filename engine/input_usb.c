@@ -0,0 +1,44 @@
+#include "input.h"
+
+#include <libmouse.h>
+#include <stddef.h>
+#include <psp2/kernel/threadmgr/thread.h>
+
+static int _usb_read(void *data, engine_timed_event *out, int max)
+{
+  (void)data;
+  if (!libmouse_usb_in_attached())
+  {
+    sceKernelDelayThread(10000);
+    return 0;
+  }
+
+  // usb read is blocking
+  uint8_t reply[64] = {0};
+  int res           = libmouse_usb_read(reply, 64);
+  if (res <= 0)
+    return 0;
+
+  uint64_t now = engine_now_us();
+  engine_event events[16];
+  int count = engine_decode_usb(reply, res, events, max < 16 ? max : 16);
+  for (int i = 0; i < count; i++)
+  {
+    out[i].time_us = now;
+    out[i].ev      = events[i];
+  }
+  return count;
+}
+
+static void _usb_close(void *data)
+{
+  (void)data;
+}
+
+int engine_input_usb(struct engine_input *in)
+{
+  in->data  = NULL;
+  in->read  = _usb_read;
+  in->close = _usb_close;
+  return 0;
+}
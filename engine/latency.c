@@ -0,0 +1,110 @@
+#include "latency.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void latency_probe_init(latency_probe *p, int sample_rate, int buffer_frames)
+{
+  memset(p, 0, sizeof(latency_probe));
+  p->sample_rate   = sample_rate;
+  p->buffer_frames = buffer_frames;
+}
+
+void latency_probe_note_on(latency_probe *p, uint64_t input_us, uint64_t applied_us, int silent)
+{
+  if (p->pending || !silent)
+  {
+    p->skipped++;
+    return;
+  }
+  p->pending    = 1;
+  p->input_us   = input_us;
+  p->applied_us = applied_us;
+}
+
+void latency_probe_block(latency_probe *p, uint64_t render_end_us, int onset)
+{
+  if (!p->pending)
+    return;
+
+  if (onset < 0)
+  {
+    if (render_end_us - p->applied_us > LATENCY_TIMEOUT_US)
+    {
+      p->pending = 0;
+      p->skipped++;
+    }
+    return;
+  }
+
+  int i         = p->count++ % LATENCY_MAX_SAMPLES;
+  p->queue[i]   = p->applied_us > p->input_us ? (p->applied_us - p->input_us) / 1000.0f : 0.0f;
+  p->render[i]  = (render_end_us - p->applied_us) / 1000.0f;
+  p->buffer[i]  = (p->buffer_frames + onset) * 1000.0f / p->sample_rate;
+  p->pending    = 0;
+}
+
+static int _cmp_float(const void *a, const void *b)
+{
+  float x = *(const float *)a, y = *(const float *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void _dist(float *v, int n, engine_latency_dist *out)
+{
+  memset(out, 0, sizeof(engine_latency_dist));
+  if (!n)
+    return;
+
+  qsort(v, n, sizeof(float), _cmp_float);
+  double sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += v[i];
+
+  out->min  = v[0];
+  out->mean = sum / n;
+  out->p50  = v[n / 2];
+  out->p95  = v[(int)(n * 0.95)];
+  out->p99  = v[(int)(n * 0.99)];
+  out->max  = v[n - 1];
+}
+
+void latency_probe_report(const latency_probe *p, engine_latency_report *out)
+{
+  int n = p->count < LATENCY_MAX_SAMPLES ? p->count : LATENCY_MAX_SAMPLES;
+  memset(out, 0, sizeof(engine_latency_report));
+  out->count   = p->count;
+  out->skipped = p->skipped;
+
+  float *tmp = malloc(sizeof(float) * (n ? n : 1));
+  if (!tmp)
+    return;
+
+  memcpy(tmp, p->queue, sizeof(float) * n);
+  _dist(tmp, n, &out->queue);
+  memcpy(tmp, p->render, sizeof(float) * n);
+  _dist(tmp, n, &out->render);
+  memcpy(tmp, p->buffer, sizeof(float) * n);
+  _dist(tmp, n, &out->buffer);
+
+  for (int i = 0; i < n; i++)
+    tmp[i] = p->queue[i] + p->render[i] + p->buffer[i];
+  _dist(tmp, n, &out->total);
+
+  free(tmp);
+}
+
+void engine_latency_print(const engine_latency_report *r, FILE *f)
+{
+  const struct
+  {
+    const char *name;
+    const engine_latency_dist *d;
+  } rows[] = {{"queue", &r->queue}, {"render", &r->render}, {"buffer", &r->buffer}, {"total", &r->total}};
+
+  fprintf(f, "latency over %d notes (%d skipped), ms\n", r->count, r->skipped);
+  fprintf(f, "  %-8s %8s %8s %8s %8s %8s %8s\n", "stage", "min", "mean", "p50", "p95", "p99", "max");
+  for (int i = 0; i < 4; i++)
+    fprintf(f, "  %-8s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", rows[i].name, rows[i].d->min, rows[i].d->mean,
+            rows[i].d->p50, rows[i].d->p95, rows[i].d->p99, rows[i].d->max);
+}
@@ -0,0 +1,45 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+// Note-on to audio latency probe, engine internal.
+// Driven from engine.c under the engine lock; reports go through engine_latency_get().
+
+#include <stdint.h>
+
+#include "engine.h"
+
+#define LATENCY_MAX_SAMPLES 4096
+
+// notes that don't become audible within this time are dropped
+#define LATENCY_TIMEOUT_US 1000000
+
+typedef struct
+{
+  int sample_rate;
+  int buffer_frames;
+
+  // note being measured
+  int pending;
+  uint64_t input_us;
+  uint64_t applied_us;
+
+  // last LATENCY_MAX_SAMPLES measurements per stage, in ms
+  float queue[LATENCY_MAX_SAMPLES];
+  float render[LATENCY_MAX_SAMPLES];
+  float buffer[LATENCY_MAX_SAMPLES];
+  int count;
+  int skipped;
+} latency_probe;
+
+void latency_probe_init(latency_probe *p, int sample_rate, int buffer_frames);
+
+// A note-on was applied. Only notes hitting a silent synth are measured,
+// otherwise the onset can't be told apart from what is already playing.
+void latency_probe_note_on(latency_probe *p, uint64_t input_us, uint64_t applied_us, int silent);
+
+// A render call finished; onset is the first audible frame in it or -1
+void latency_probe_block(latency_probe *p, uint64_t render_end_us, int onset);
+
+void latency_probe_report(const latency_probe *p, engine_latency_report *out);
+
+#endif // __LATENCY_H__
@@ -0,0 +1,107 @@
+#include "engine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int _null_write(void *data, const int16_t *frames, int count)
+{
+  (void)data;
+  (void)frames;
+  return count;
+}
+
+static void _null_close(void *data)
+{
+  (void)data;
+}
+
+int engine_sink_null(struct engine_sink *sink)
+{
+  sink->data  = NULL;
+  sink->write = _null_write;
+  sink->close = _null_close;
+  return 0;
+}
+
+struct wav_sink
+{
+  FILE *f;
+  int sample_rate;
+  uint32_t frames;
+};
+
+static void _put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void _put_u32(uint8_t *p, uint32_t v)
+{
+  _put_u16(p, v & 0xFFFF);
+  _put_u16(p + 2, v >> 16);
+}
+
+static void _wav_header(uint8_t *h, int sample_rate, uint32_t frames)
+{
+  uint32_t data_size = frames * 4;
+  memcpy(h, "RIFF", 4);
+  _put_u32(h + 4, 36 + data_size);
+  memcpy(h + 8, "WAVEfmt ", 8);
+  _put_u32(h + 16, 16);
+  _put_u16(h + 20, 1); // pcm
+  _put_u16(h + 22, 2); // stereo
+  _put_u32(h + 24, sample_rate);
+  _put_u32(h + 28, sample_rate * 4);
+  _put_u16(h + 32, 4);
+  _put_u16(h + 34, 16);
+  memcpy(h + 36, "data", 4);
+  _put_u32(h + 40, data_size);
+}
+
+static int _wav_write(void *data, const int16_t *frames, int count)
+{
+  struct wav_sink *w = data;
+  // wav is little endian, so are all our targets
+  int written = (int)fwrite(frames, 4, count, w->f);
+  w->frames += written;
+  return written;
+}
+
+static void _wav_close(void *data)
+{
+  struct wav_sink *w = data;
+  uint8_t h[44];
+
+  // patch sizes now that we know them
+  _wav_header(h, w->sample_rate, w->frames);
+  fseek(w->f, 0, SEEK_SET);
+  fwrite(h, 1, sizeof(h), w->f);
+  fclose(w->f);
+  free(w);
+}
+
+int engine_sink_wav(struct engine_sink *sink, const char *path, int sample_rate)
+{
+  struct wav_sink *w = calloc(1, sizeof(struct wav_sink));
+  if (!w)
+    return -1;
+
+  w->sample_rate = sample_rate;
+  w->f           = fopen(path, "wb");
+  if (!w->f)
+  {
+    free(w);
+    return -1;
+  }
+
+  uint8_t h[44];
+  _wav_header(h, sample_rate, 0);
+  fwrite(h, 1, sizeof(h), w->f);
+
+  sink->data  = w;
+  sink->write = _wav_write;
+  sink->close = _wav_close;
+  return 0;
+}
@@ -0,0 +1,273 @@
+#include "smf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  uint32_t tick;
+  uint32_t seq; // keeps file order for events on the same tick
+  uint32_t tempo;
+  engine_event ev;
+} smf_raw_event;
+
+typedef struct
+{
+  smf_raw_event *events;
+  int count;
+  int max;
+} smf_raw_list;
+
+static uint32_t _be32(const uint8_t *p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint16_t _be16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static int _varlen(const uint8_t **p, const uint8_t *end, uint32_t *out)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    if (*p >= end)
+      return -1;
+    uint8_t b = *(*p)++;
+    v         = (v << 7) | (b & 0x7F);
+    if (!(b & 0x80))
+    {
+      *out = v;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static smf_raw_event *_push(smf_raw_list *l)
+{
+  if (l->count == l->max)
+  {
+    int max            = l->max ? l->max * 2 : 1024;
+    smf_raw_event *tmp = realloc(l->events, max * sizeof(smf_raw_event));
+    if (!tmp)
+      return NULL;
+    l->events = tmp;
+    l->max    = max;
+  }
+  return &l->events[l->count++];
+}
+
+static int _parse_track(smf_raw_list *l, const uint8_t *p, const uint8_t *end, uint32_t *seq)
+{
+  uint32_t tick  = 0;
+  uint8_t status = 0;
+
+  while (p < end)
+  {
+    uint32_t delta;
+    if (_varlen(&p, end, &delta) < 0 || p >= end)
+      return -1;
+    tick += delta;
+
+    uint8_t b = *p;
+    if (b & 0x80)
+      p++;
+    else if (!status)
+      return -1; // running status without a previous status
+    else
+      b = status;
+
+    if (b == 0xFF)
+    {
+      uint32_t len;
+      if (p >= end)
+        return -1;
+      uint8_t type = *p++;
+      if (_varlen(&p, end, &len) < 0 || len > (uint32_t)(end - p))
+        return -1;
+      if (type == 0x2F)
+        break; // end of track
+      if (type == MIDI_SET_TEMPO && len == 3)
+      {
+        smf_raw_event *e = _push(l);
+        if (!e)
+          return -2;
+        memset(e, 0, sizeof(*e));
+        e->tick    = tick;
+        e->seq     = (*seq)++;
+        e->tempo   = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+        e->ev.type = MIDI_SET_TEMPO;
+      }
+      p += len;
+      status = 0;
+    }
+    else if (b == 0xF0 || b == 0xF7)
+    {
+      uint32_t len;
+      if (_varlen(&p, end, &len) < 0 || len > (uint32_t)(end - p))
+        return -1;
+      p += len;
+      status = 0;
+    }
+    else if (b >= 0x80 && b < 0xF0)
+    {
+      int n = ((b & 0xF0) == MIDI_PROGRAM_CHANGE || (b & 0xF0) == MIDI_CHANNEL_PRESSURE) ? 1 : 2;
+      if (end - p < n)
+        return -1;
+
+      smf_raw_event *e = _push(l);
+      if (!e)
+        return -2;
+      e->tick       = tick;
+      e->seq        = (*seq)++;
+      e->tempo      = 0;
+      e->ev.type    = b & 0xF0;
+      e->ev.channel = b & 0x0F;
+      e->ev.data1   = p[0] & 0x7F;
+      e->ev.data2   = n > 1 ? p[1] & 0x7F : 0;
+      p += n;
+      status = b;
+    }
+    else
+      return -1; // system common / realtime bytes don't belong in a file
+  }
+  return 0;
+}
+
+static int _cmp_raw(const void *a, const void *b)
+{
+  const smf_raw_event *x = a, *y = b;
+  if (x->tick != y->tick)
+    return x->tick < y->tick ? -1 : 1;
+  return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+int smf_load_memory(smf *out, const uint8_t *data, size_t size)
+{
+  const uint8_t *p = data, *end = data + size;
+  memset(out, 0, sizeof(*out));
+
+  if (size < 14 || memcmp(p, "MThd", 4) || _be32(p + 4) < 6 || _be32(p + 4) > size - 8)
+    return -2;
+
+  out->format   = _be16(p + 8);
+  out->tracks   = _be16(p + 10);
+  uint16_t div  = _be16(p + 12);
+  p += 8 + _be32(p + 4);
+
+  // format 2 (independent sequences) is rare, it gets merged like format 1
+  double tick_seconds = 0;
+  int smpte           = (div & 0x8000) != 0;
+  if (smpte)
+  {
+    int fps       = -(int8_t)(div >> 8);
+    int per_frame = div & 0xFF;
+    if (fps <= 0 || !per_frame)
+      return -2;
+    tick_seconds  = 1.0 / (fps * per_frame);
+    out->division = per_frame;
+  }
+  else
+  {
+    if (!div)
+      return -2;
+    out->division = div;
+    tick_seconds  = 0.5 / div; // 120 bpm until the first tempo event
+  }
+
+  smf_raw_list list = {0};
+  uint32_t seq      = 0;
+  int track         = 0;
+  while (end - p >= 8 && track < out->tracks)
+  {
+    uint32_t len = _be32(p + 4);
+    if (len > (size_t)(end - p) - 8)
+      break; // truncated file, keep what we have
+    if (!memcmp(p, "MTrk", 4))
+    {
+      int res = _parse_track(&list, p + 8, p + 8 + len, &seq);
+      if (res == -2)
+      {
+        free(list.events);
+        return -1;
+      }
+      track++;
+    }
+    p += 8 + len;
+  }
+  if (!track)
+  {
+    free(list.events);
+    return -2;
+  }
+
+  qsort(list.events, list.count, sizeof(smf_raw_event), _cmp_raw);
+
+  out->events = malloc((list.count ? list.count : 1) * sizeof(smf_event));
+  if (!out->events)
+  {
+    free(list.events);
+    return -1;
+  }
+
+  double time        = 0;
+  uint32_t last_tick = 0;
+  for (int i = 0; i < list.count; i++)
+  {
+    smf_raw_event *r = &list.events[i];
+    time += (r->tick - last_tick) * tick_seconds;
+    last_tick = r->tick;
+
+    if (r->ev.type == MIDI_SET_TEMPO && !smpte && r->tempo)
+      tick_seconds = r->tempo / 1e6 / out->division;
+
+    smf_event *e = &out->events[i];
+    e->time      = time;
+    e->tempo     = r->tempo;
+    e->ev        = r->ev;
+  }
+  out->count  = list.count;
+  out->length = time;
+
+  free(list.events);
+  return 0;
+}
+
+int smf_load(smf *out, const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return -1;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size <= 0)
+  {
+    fclose(f);
+    return -2;
+  }
+
+  uint8_t *data = malloc(size);
+  if (!data || fread(data, 1, size, f) != (size_t)size)
+  {
+    free(data);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+
+  int res = smf_load_memory(out, data, size);
+  free(data);
+  return res;
+}
+
+void smf_free(smf *s)
+{
+  free(s->events);
+  memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,44 @@
+#ifndef __SMF_H__
+#define __SMF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Standard MIDI File reader. All tracks are merged into one list of
+  // channel events in playback order, with tempo changes already applied
+  // to the timestamps.
+
+  typedef struct
+  {
+    double time;    // seconds from the start of the song
+    uint32_t tempo; // microseconds per quarter note, only for MIDI_SET_TEMPO
+    engine_event ev;
+  } smf_event;
+
+  typedef struct
+  {
+    smf_event *events;
+    int count;
+    int format;
+    int tracks;
+    int division; // ticks per quarter note (or per smpte frame if negative in the file)
+    double length; // time of the last event in seconds
+  } smf;
+
+  // Returns 0 on success, -1 if the file could not be read, -2 if it is not a valid midi file
+  int smf_load(smf *out, const char *path);
+  int smf_load_memory(smf *out, const uint8_t *data, size_t size);
+  void smf_free(smf *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SMF_H__
@@ -0,0 +1,270 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+
+#include "topology.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__vita__)
+#include <psp2/kernel/threadmgr/thread.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static topology_entry g_topology[TOPOLOGY_ROLE_COUNT];
+static uint8_t g_topology_initialized = 0;
+
+static const char *g_role_names[TOPOLOGY_ROLE_COUNT] = {"audio", "midi", "ui", "loader", "stream"};
+
+static const struct
+{
+  const char *name;
+  topology_priority priority;
+} g_priority_names[] = {
+    {"low", TOPOLOGY_PRIO_LOW},
+    {"normal", TOPOLOGY_PRIO_NORMAL},
+    {"high", TOPOLOGY_PRIO_HIGH},
+    {"rt", TOPOLOGY_PRIO_REALTIME},
+    {"realtime", TOPOLOGY_PRIO_REALTIME},
+};
+
+void topology_defaults()
+{
+  topology_set(TOPOLOGY_AUDIO, 1 << 1, TOPOLOGY_PRIO_REALTIME);
+  topology_set(TOPOLOGY_MIDI, 1 << 2, TOPOLOGY_PRIO_HIGH);
+  topology_set(TOPOLOGY_UI, 1 << 0, TOPOLOGY_PRIO_NORMAL);
+  topology_set(TOPOLOGY_LOADER, 0, TOPOLOGY_PRIO_NORMAL);
+  topology_set(TOPOLOGY_STREAM, 1 << 2, TOPOLOGY_PRIO_HIGH);
+  g_topology_initialized = 1;
+}
+
+void topology_set(topology_role role, uint32_t cores, topology_priority priority)
+{
+  if (role >= TOPOLOGY_ROLE_COUNT)
+    return;
+  g_topology[role].cores    = cores;
+  g_topology[role].priority = priority;
+}
+
+const topology_entry *topology_get(topology_role role)
+{
+  if (!g_topology_initialized)
+    topology_defaults();
+  return role < TOPOLOGY_ROLE_COUNT ? &g_topology[role] : NULL;
+}
+
+const char *topology_role_name(topology_role role)
+{
+  return role < TOPOLOGY_ROLE_COUNT ? g_role_names[role] : "?";
+}
+
+static int _parse_entry(const char *s, size_t len)
+{
+  char buf[64];
+  if (len >= sizeof(buf))
+    return -1;
+  memcpy(buf, s, len);
+  buf[len] = 0;
+
+  char *eq = strchr(buf, '=');
+  if (!eq)
+    return -1;
+  *eq = 0;
+
+  int role = -1;
+  for (int i = 0; i < TOPOLOGY_ROLE_COUNT; i++)
+    if (!strcmp(buf, g_role_names[i]))
+      role = i;
+  if (role < 0)
+    return -1;
+
+  char *prio = strchr(eq + 1, ':');
+  if (prio)
+    *prio++ = 0;
+
+  uint32_t cores = 0;
+  char *c        = eq + 1;
+  if (*c == '*')
+    cores = 0;
+  else
+  {
+    while (*c)
+    {
+      if (*c < '0' || *c > '9')
+        return -1;
+      int core = 0;
+      while (*c >= '0' && *c <= '9')
+        core = core * 10 + (*c++ - '0');
+      if (core > 31)
+        return -1;
+      cores |= 1u << core;
+      if (*c == '+')
+        c++;
+      else if (*c)
+        return -1;
+    }
+  }
+
+  topology_priority priority = topology_get((topology_role)role)->priority;
+  if (prio && *prio)
+  {
+    int found = 0;
+    for (size_t i = 0; i < sizeof(g_priority_names) / sizeof(g_priority_names[0]); i++)
+    {
+      if (!strcmp(prio, g_priority_names[i].name))
+      {
+        priority = g_priority_names[i].priority;
+        found    = 1;
+      }
+    }
+    if (!found)
+      return -1;
+  }
+
+  topology_set((topology_role)role, cores, priority);
+  return 0;
+}
+
+int topology_parse(const char *spec)
+{
+  if (!g_topology_initialized)
+    topology_defaults();
+
+  while (spec && *spec)
+  {
+    while (*spec == ',' || *spec == ' ' || *spec == '\t' || *spec == '\n' || *spec == '\r')
+      spec++;
+    if (!*spec)
+      break;
+    size_t len = strcspn(spec, ", \t\r\n");
+    if (_parse_entry(spec, len) < 0)
+      return -1;
+    spec += len;
+  }
+  return 0;
+}
+
+int topology_load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return 0;
+
+  char line[256];
+  int ret = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = 0;
+    if (topology_parse(line) < 0)
+      ret = -1;
+  }
+  fclose(f);
+  return ret;
+}
+
+#if defined(__vita__)
+
+// user thread priorities go from 64 (highest) to 191 (lowest), 160 is the default
+static int _native_priority(topology_priority priority)
+{
+  switch (priority)
+  {
+    case TOPOLOGY_PRIO_REALTIME:
+      return 64;
+    case TOPOLOGY_PRIO_HIGH:
+      return 96;
+    case TOPOLOGY_PRIO_LOW:
+      return 191;
+    default:
+      return 160;
+  }
+}
+
+int topology_apply(topology_role role)
+{
+  const topology_entry *e = topology_get(role);
+  if (!e)
+    return -1;
+
+  SceUID thid = sceKernelGetThreadId();
+  int ret     = sceKernelChangeThreadPriority(thid, _native_priority(e->priority));
+
+  // only user cores 0-2 are available to applications
+  int mask = (e->cores & 7) << 16; // SCE_KERNEL_CPU_MASK_USER_0 = 1 << 16
+  if (mask)
+  {
+    int res = sceKernelChangeThreadCpuAffinityMask(thid, mask);
+    if (res < 0)
+      ret = res;
+  }
+  return ret < 0 ? ret : 0;
+}
+
+#elif defined(__linux__)
+
+int topology_apply(topology_role role)
+{
+  const topology_entry *e = topology_get(role);
+  if (!e)
+    return -1;
+
+  int ret = 0;
+  if (e->cores)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < 32; i++)
+      if (e->cores & (1u << i))
+        CPU_SET(i, &set);
+    int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (res)
+      ret = -res;
+  }
+
+  // SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit, fall back to nice values when refused
+  struct sched_param param = {0};
+  int res                  = 0;
+  switch (e->priority)
+  {
+    case TOPOLOGY_PRIO_REALTIME:
+      param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+      res                  = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if (res)
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -15);
+      break;
+    case TOPOLOGY_PRIO_HIGH:
+      param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 20;
+      res                  = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if (res)
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -5);
+      break;
+    case TOPOLOGY_PRIO_LOW:
+      res = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+      setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+      break;
+    default:
+      res = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+      break;
+  }
+  if (res && !ret)
+    ret = -res;
+  return ret;
+}
+
+#else
+
+int topology_apply(topology_role role)
+{
+  (void)role;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Threads the app cares about. Each one applies its own placement
+  // from inside the thread (SDL doesn't hand us the audio thread id).
+  typedef enum
+  {
+    TOPOLOGY_AUDIO = 0, // SDL audio callback / tsf render
+    TOPOLOGY_MIDI,      // blocking usb reader
+    TOPOLOGY_UI,        // SDL event loop and drawing
+    TOPOLOGY_LOADER,    // startup asset loading workers
+    TOPOLOGY_STREAM,    // soundfont disk streaming
+    TOPOLOGY_ROLE_COUNT
+  } topology_role;
+
+  // Abstract priority levels, mapped to native values per platform.
+  // Ordering matters: nothing below REALTIME may preempt the audio thread.
+  typedef enum
+  {
+    TOPOLOGY_PRIO_LOW = 0,
+    TOPOLOGY_PRIO_NORMAL,
+    TOPOLOGY_PRIO_HIGH,
+    TOPOLOGY_PRIO_REALTIME
+  } topology_priority;
+
+  typedef struct
+  {
+    uint32_t cores; // bitmask of allowed cores, 0 = leave affinity alone
+    topology_priority priority;
+  } topology_entry;
+
+  // Resets every role to the built-in defaults:
+  // audio on core 1 (realtime), midi on core 2 (high), ui on core 0 (normal),
+  // loaders on any core (normal) since nothing else runs yet,
+  // disk streaming next to midi on core 2 (high) since both mostly wait.
+  void topology_defaults();
+
+  void topology_set(topology_role role, uint32_t cores, topology_priority priority);
+  const topology_entry *topology_get(topology_role role);
+
+  // Parses a spec like "audio=1:rt,midi=2:high,ui=0:normal".
+  // Cores are listed with '+' ("ui=0+2:low"), '*' means any core.
+  // Returns 0 on success, -1 on the first malformed entry (entries before it are kept).
+  int topology_parse(const char *spec);
+
+  // Reads a spec from a text file, one or more entries per line, '#' starts a comment.
+  // Missing file is not an error and leaves the current configuration untouched.
+  int topology_load(const char *path);
+
+  // Applies the role's priority and affinity to the calling thread.
+  // Returns 0 on success, negative native error otherwise (placement is best effort).
+  int topology_apply(topology_role role);
+
+  const char *topology_role_name(topology_role role);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TOPOLOGY_H__
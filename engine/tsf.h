@@ -0,0 +1,3530 @@
+/* TinySoundFont - v0.9 - SoundFont2 synthesizer - https://github.com/schellingb/TinySoundFont
+                                     no warranty implied; use at your own risk
+   Do this:
+      #define TSF_IMPLEMENTATION
+   before you include this file in *one* C or C++ file to create the implementation.
+   // i.e. it should look like this:
+   #include ...
+   #include ...
+   #define TSF_IMPLEMENTATION
+   #include "tsf.h"
+
+   [OPTIONAL] #define TSF_NO_STDIO to remove stdio dependency
+   [OPTIONAL] #define TSF_MALLOC, TSF_REALLOC, and TSF_FREE to avoid stdlib.h
+   [OPTIONAL] #define TSF_MEMCPY, TSF_MEMSET to avoid string.h
+   [OPTIONAL] #define TSF_POW, TSF_POWF, TSF_EXPF, TSF_LOG, TSF_TAN, TSF_LOG10, TSF_SQRT to avoid math.h
+   [OPTIONAL] #define TSF_NO_SIMD to render voices with the scalar kernel even if NEON or SSE is available
+   [OPTIONAL] #define TSF_SAMPLES_SHORT to keep sample data as 16-bit in memory, halving its size (not with SF3 support)
+   [OPTIONAL] #define TSF_RT_ASSERT(x) to check that render and event functions don't allocate after tsf_set_realtime,
+              e.g. as assert(x); TSF_MALLOC and TSF_REALLOC then go through a check on a thread-local flag
+   [OPTIONAL] #define TSF_CLOCK() to a cheap unsigned tick counter (cycles, microseconds, ...) to have tsf_get_stats time rendering
+   [OPTIONAL] #define TSF_STREAM_BARRIER to a full memory barrier for streaming on compilers other than GCC, clang or MSVC
+   [OPTIONAL] #define TSF_FSEEK, TSF_FTELL and TSF_FILEOFF to 64-bit file positioning (default _fseeki64 on MSVC, fseeko64
+              with newlib's large file support, otherwise fseeko with off_t, which needs _FILE_OFFSET_BITS=64 on 32-bit
+              systems); paged fonts with samples past what they can reach don't load
+
+   NOT YET IMPLEMENTED
+     - Support for ChorusEffectsSend and ReverbEffectsSend generators
+     - Better low-pass filter without lowering performance too much
+     - Support for modulators
+
+   LICENSE (MIT)
+
+   Copyright (C) 2017-2023 Bernhard Schelling
+   Based on SFZero, Copyright (C) 2012 Steve Folta (https://github.com/stevefolta/SFZero)
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+   software and associated documentation files (the "Software"), to deal in the Software
+   without restriction, including without limitation the rights to use, copy, modify, merge,
+   publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+   to whom the Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+   INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+   PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+   USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef TSF_INCLUDE_TSF_INL
+#define TSF_INCLUDE_TSF_INL
+
+#ifdef __cplusplus
+extern "C" {
+#  define CPP_DEFAULT0 = 0
+#else
+#  define CPP_DEFAULT0
+#endif
+
+//define this if you want the API functions to be static
+#ifdef TSF_STATIC
+#define TSFDEF static
+#else
+#define TSFDEF extern
+#endif
+
+// The load functions will return a pointer to a struct tsf which all functions
+// thereafter take as the first parameter.
+// On error the tsf_load* functions will return NULL most likely due to invalid
+// data (or if the file did not exist in tsf_load_filename).
+typedef struct tsf tsf;
+
+#ifndef TSF_NO_STDIO
+// Directly load a SoundFont from a .sf2 file path
+TSFDEF tsf* tsf_load_filename(const char* filename);
+
+// Load a SoundFont from a .sf2 file path but leave the sample data in the file until
+// tsf_load_preset_samples is called for the presets that will be played.
+// The file stays open until tsf_close. Regions without loaded samples don't play.
+// (SF3 files are not supported this way.)
+TSFDEF tsf* tsf_load_filename_paged(const char* filename);
+
+// Read the samples used by a preset of a SoundFont loaded with tsf_load_filename_paged
+// (does nothing for other SoundFonts). Samples stay loaded until tsf_close.
+// Returns 0 if reading or allocating failed, otherwise 1.
+// It may run at the same time as rendering and note events (regions play once their samples are in),
+// but not with itself, tsf_stream_update, tsf_set_streaming or tsf_close.
+TSFDEF int tsf_load_preset_samples(tsf* f, int preset_index);
+
+// Stream long samples of a SoundFont loaded with tsf_load_filename_paged from the file while they play.
+// Only the first head_ms of each sample and its loop get loaded by tsf_load_preset_samples (so call
+// this first), up to max_streams voices at once read the rest through ring buffers filled by
+// tsf_stream_update. Voices that find no free ring play the head only. Returns 0 if out of memory.
+TSFDEF int tsf_set_streaming(tsf* f, int head_ms, int max_streams);
+
+// Reads ahead for the streaming voices, call this regularly from a separate I/O thread.
+// It may run at the same time as rendering and note events but not with tsf_load_preset_samples,
+// tsf_set_streaming or tsf_close. Returns the number of samples read, 0 when there was nothing to do.
+TSFDEF int tsf_stream_update(tsf* f);
+
+// Write a SoundFont loaded with tsf_load_filename or tsf_load_memory to a compiled font file holding its
+// presets, regions, lookup tables and samples as they are laid out in memory.
+// source_size and source_time are stored with it to tell later which SoundFont file it was compiled from
+// (e.g. its size and modification time), see tsf_get_compiled_source.
+// Returns 0 if writing failed or the SoundFont was loaded paged, otherwise 1.
+TSFDEF int tsf_save_compiled(const tsf* f, const char* filename, long long source_size, long long source_time);
+
+// Read the source_size and source_time a compiled font file was written with, to check if it is still
+// up to date with its SoundFont before loading it. Returns 0 if the file doesn't exist or wouldn't load.
+TSFDEF int tsf_get_compiled_source(const char* filename, long long* source_size, long long* source_time);
+
+// Load a compiled font file written by tsf_save_compiled with a single read and no parsing.
+// Returns NULL if the file doesn't exist or was written by another version or build configuration of tsf
+// (load the SoundFont and compile it again then). Compiled fonts play like the SoundFont they came from.
+TSFDEF tsf* tsf_load_compiled(const char* filename);
+#endif
+
+// Load a SoundFont from a block of memory
+TSFDEF tsf* tsf_load_memory(const void* buffer, int size);
+
+// Stream structure for the generic loading
+struct tsf_stream
+{
+	// Custom data given to the functions as the first parameter
+	void* data;
+
+	// Function pointer will be called to read 'size' bytes into ptr (returns number of read bytes)
+	int (*read)(void* data, void* ptr, unsigned int size);
+
+	// Function pointer will be called to skip ahead over 'count' bytes (returns 1 on success, 0 on error)
+	int (*skip)(void* data, unsigned int count);
+};
+
+// Generic SoundFont loading method using the stream structure above
+TSFDEF tsf* tsf_load(struct tsf_stream* stream);
+
+// Copy a tsf instance from an existing one, use tsf_close to close it as well.
+// All copied tsf instances and their original instance are linked, and share the underlying soundfont.
+// This allows loading a soundfont only once, but using it for multiple independent playbacks.
+// (This function isn't thread-safe without locking.)
+TSFDEF tsf* tsf_copy(tsf* f);
+
+// Free the memory related to this tsf instance
+TSFDEF void tsf_close(tsf* f);
+
+// Stop all playing notes immediately and reset all channel parameters
+TSFDEF void tsf_reset(tsf* f);
+
+// Returns the preset index from a bank and preset number, or -1 if it does not exist in the loaded SoundFont
+TSFDEF int tsf_get_presetindex(const tsf* f, int bank, int preset_number);
+
+// Returns the number of presets in the loaded SoundFont
+TSFDEF int tsf_get_presetcount(const tsf* f);
+
+// Returns the name of a preset index >= 0 and < tsf_get_presetcount()
+TSFDEF const char* tsf_get_presetname(const tsf* f, int preset_index);
+
+// Returns the name of a preset by bank and preset number
+TSFDEF const char* tsf_bank_get_presetname(const tsf* f, int bank, int preset_number);
+
+// Supported output modes by the render methods
+enum TSFOutputMode
+{
+	// Two channels with single left/right samples one after another
+	TSF_STEREO_INTERLEAVED,
+	// Two channels with all samples for the left channel first then right
+	TSF_STEREO_UNWEAVED,
+	// A single channel (stereo instruments are mixed into center)
+	TSF_MONO
+};
+
+// Thread safety:
+//
+// 1. Rendering / voices:
+//
+// Your audio output which calls the tsf_render* functions will most likely
+// run on a different thread than where the playback tsf_note* functions
+// are called. In which case some sort of concurrency control like a
+// mutex needs to be used so they are not called at the same time.
+// Alternatively, you can pre-allocate a maximum number of voices that can
+// play simultaneously by calling tsf_set_max_voices after loading.
+// That way memory re-allocation will not happen during tsf_note_on and
+// TSF should become mostly thread safe.
+// There is a theoretical chance that ending notes would negatively influence
+// a voice that is rendering at the time but it is hard to say.
+// Also be aware, this has not been tested much.
+//
+// 2. Channels:
+//
+// Calls to tsf_channel_set_... functions may allocate new channels
+// if no channel with that number was previously used. Make sure to
+// create all channels at the beginning as required if you call tsf_render*
+// from a different thread.
+//
+// 3. Real-time use:
+//
+// tsf_set_realtime does both of the above at once and guarantees that rendering,
+// note and channel functions never allocate afterwards.
+
+// Setup the parameters for the voice render methods
+//   outputmode: if mono or stereo and how stereo channel data is ordered
+//   samplerate: the number of samples per second (output frequency)
+//   global_gain_db: volume gain in decibels (>0 means higher, <0 means lower)
+TSFDEF void tsf_set_output(tsf* f, enum TSFOutputMode outputmode, int samplerate, float global_gain_db CPP_DEFAULT0);
+
+// Set the global gain as a volume factor
+//   global_gain: the desired volume where 1.0 is 100%
+TSFDEF void tsf_set_volume(tsf* f, float global_gain);
+
+// Set the maximum number of voices to play simultaneously
+// Depending on the soundfond, one note can cause many new voices to be started,
+// so don't keep this number too low or otherwise sounds may not play.
+//   max_voices: maximum number to pre-allocate and set the limit to
+//   (tsf_set_max_voices returns 0 if allocation failed, otherwise 1)
+TSFDEF int tsf_set_max_voices(tsf* f, int max_voices);
+
+// Pre-allocate max_voices voices and the channels 0 to max_channels - 1, then stop allocating:
+// notes steal the voice furthest into its release once all voices play (like with tsf_set_max_voices),
+// channel functions ignore channels past the allocated ones and tsf_reset keeps the channels.
+// Call this once after loading. Define TSF_RT_ASSERT to catch render or event functions still trying to allocate.
+//   (tsf_set_realtime returns 0 if allocation failed, otherwise 1)
+TSFDEF int tsf_set_realtime(tsf* f, int max_voices, int max_channels);
+
+// Start playing a note
+//   preset_index: preset index >= 0 and < tsf_get_presetcount()
+//   key: note value between 0 and 127 (60 being middle C)
+//   vel: velocity as a float between 0.0 (equal to note off) and 1.0 (full)
+//   bank: instrument bank number (alternative to preset_index)
+//   preset_number: preset number (alternative to preset_index)
+//   (tsf_note_on returns 0 if the allocation of a new voice failed, otherwise 1)
+//   (tsf_bank_note_on returns 0 if preset does not exist or allocation failed, otherwise 1)
+TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel);
+TSFDEF int tsf_bank_note_on(tsf* f, int bank, int preset_number, int key, float vel);
+
+// Stop playing a note
+//   (bank_note_off returns 0 if preset does not exist, otherwise 1)
+TSFDEF void tsf_note_off(tsf* f, int preset_index, int key);
+TSFDEF int  tsf_bank_note_off(tsf* f, int bank, int preset_number, int key);
+
+// Stop playing all notes (end with sustain and release)
+TSFDEF void tsf_note_off_all(tsf* f);
+
+// Returns the number of active voices
+TSFDEF int tsf_active_voice_count(tsf* f);
+
+// Voice and render statistics, see tsf_get_stats
+struct tsf_stats
+{
+	int activeVoices;    // voices playing, including the ones in their release
+	int releasingVoices; // voices in their release
+	int peakVoices;      // most voices playing at once during the window
+	int stolenVoices;    // voices killed during the window to start new ones
+	int refusedVoices;   // regions not played during the window, with no voice to steal or failing to allocate one
+
+	// Tick counts are from TSF_CLOCK and stay 0 if it isn't defined
+	int renderCalls;           // tsf_render_short and tsf_render_float calls during the window
+	int renderFrames;          // frames they rendered
+	float callTicks;           // average ticks per render call
+	float voiceTicks;          // average ticks per playing voice and rendered frame
+	unsigned int maxCallTicks; // longest render call
+};
+
+// Fills stats and starts a new window, so the counts and timings cover the time since the previous call
+TSFDEF void tsf_get_stats(tsf* f, struct tsf_stats* stats);
+
+// Render output samples into a buffer
+// You can either render as signed 16-bit values (tsf_render_short) or
+// as 32-bit float values (tsf_render_float)
+//   buffer: target buffer of size samples * output_channels * sizeof(type)
+//   samples: number of samples to render
+//   flag_mixing: if 0 clear the buffer first, otherwise mix into existing data
+TSFDEF void tsf_render_short(tsf* f, short* buffer, int samples, int flag_mixing CPP_DEFAULT0);
+TSFDEF void tsf_render_float(tsf* f, float* buffer, int samples, int flag_mixing CPP_DEFAULT0);
+
+// Higher level channel based functions, set up channel parameters
+//   channel: channel number
+//   preset_index: preset index >= 0 and < tsf_get_presetcount()
+//   preset_number: preset number (alternative to preset_index)
+//   flag_mididrums: 0 for normal channels, otherwise apply MIDI drum channel rules
+//   bank: instrument bank number (alternative to preset_index)
+//   pan: stereo panning value from 0.0 (left) to 1.0 (right) (default 0.5 center)
+//   volume: linear volume scale factor (default 1.0 full)
+//   pitch_wheel: pitch wheel position 0 to 16383 (default 8192 unpitched)
+//   pitch_range: range of the pitch wheel in semitones (default 2.0, total +/- 2 semitones)
+//   tuning: tuning of all playing voices in semitones (default 0.0, standard (A440) tuning)
+//   (tsf_set_preset_number and set_bank_preset return 0 if preset does not exist, otherwise 1)
+//   (tsf_channel_set_... return 0 if a new channel needed allocation and that failed, otherwise 1)
+// Playing voices pick up pan, volume, pitch wheel, pitch range and tuning changes at the start of the next
+// render call, so a stream of them between two renders costs one update per voice.
+TSFDEF int tsf_channel_set_presetindex(tsf* f, int channel, int preset_index);
+TSFDEF int tsf_channel_set_presetnumber(tsf* f, int channel, int preset_number, int flag_mididrums CPP_DEFAULT0);
+TSFDEF int tsf_channel_set_bank(tsf* f, int channel, int bank);
+TSFDEF int tsf_channel_set_bank_preset(tsf* f, int channel, int bank, int preset_number);
+TSFDEF int tsf_channel_set_pan(tsf* f, int channel, float pan);
+TSFDEF int tsf_channel_set_volume(tsf* f, int channel, float volume);
+TSFDEF int tsf_channel_set_pitchwheel(tsf* f, int channel, int pitch_wheel);
+TSFDEF int tsf_channel_set_pitchrange(tsf* f, int channel, float pitch_range);
+TSFDEF int tsf_channel_set_tuning(tsf* f, int channel, float tuning);
+
+// Start or stop playing notes on a channel (needs channel preset to be set)
+//   channel: channel number
+//   key: note value between 0 and 127 (60 being middle C)
+//   vel: velocity as a float between 0.0 (equal to note off) and 1.0 (full)
+//   (tsf_channel_note_on returns 0 on allocation failure of new voice, otherwise 1)
+TSFDEF int tsf_channel_note_on(tsf* f, int channel, int key, float vel);
+TSFDEF void tsf_channel_note_off(tsf* f, int channel, int key);
+TSFDEF void tsf_channel_note_off_all(tsf* f, int channel); //end with sustain and release
+TSFDEF void tsf_channel_sounds_off_all(tsf* f, int channel); //end immediately
+
+// Apply a MIDI control change to the channel (not all controllers are supported!)
+//    (tsf_channel_midi_control returns 0 on allocation failure of new channel, otherwise 1)
+TSFDEF int tsf_channel_midi_control(tsf* f, int channel, int controller, int control_value);
+
+// Get current values set on the channels
+TSFDEF int tsf_channel_get_preset_index(tsf* f, int channel);
+TSFDEF int tsf_channel_get_preset_bank(tsf* f, int channel);
+TSFDEF int tsf_channel_get_preset_number(tsf* f, int channel);
+TSFDEF float tsf_channel_get_pan(tsf* f, int channel);
+TSFDEF float tsf_channel_get_volume(tsf* f, int channel);
+TSFDEF int tsf_channel_get_pitchwheel(tsf* f, int channel);
+TSFDEF float tsf_channel_get_pitchrange(tsf* f, int channel);
+TSFDEF float tsf_channel_get_tuning(tsf* f, int channel);
+
+#ifdef __cplusplus
+#  undef CPP_DEFAULT0
+}
+#endif
+
+// end header
+// ---------------------------------------------------------------------------------------------------------
+#endif //TSF_INCLUDE_TSF_INL
+
+#ifdef TSF_IMPLEMENTATION
+#undef TSF_IMPLEMENTATION
+
+// The lower this block size is the more accurate the effects are.
+// Increasing the value significantly lowers the CPU usage of the voice rendering.
+// If LFO affects the low-pass filter it can be hearable even as low as 8.
+#ifndef TSF_RENDER_EFFECTSAMPLEBLOCK
+#define TSF_RENDER_EFFECTSAMPLEBLOCK 64
+#endif
+
+// When using tsf_render_short, to do the conversion a buffer of a fixed size is
+// allocated on the stack. On low memory platforms this could be made smaller.
+// Increasing this above 512 should not have a significant impact on performance.
+// The value should be a multiple of TSF_RENDER_EFFECTSAMPLEBLOCK.
+#ifndef TSF_RENDER_SHORTBUFFERBLOCK
+#define TSF_RENDER_SHORTBUFFERBLOCK 512
+#endif
+
+// Grace release time for quick voice off (avoid clicking noise)
+#define TSF_FASTRELEASETIME 0.01f
+
+#if !defined(TSF_MALLOC) || !defined(TSF_FREE) || !defined(TSF_REALLOC)
+#  include <stdlib.h>
+#  define TSF_MALLOC  malloc
+#  define TSF_FREE    free
+#  define TSF_REALLOC realloc
+#endif
+
+#ifdef TSF_RT_ASSERT
+// Set on entry to a render or event function of a font in real-time mode and cleared on entry to the
+// functions that may allocate (loading, paging, streaming setup, tsf_set_max_voices, ...), so every
+// TSF_MALLOC and TSF_REALLOC reached from a real-time call on this thread trips the assert
+#  if defined(_MSC_VER)
+static __declspec(thread) int tsf_rt_call;
+#  elif defined(__GNUC__) || defined(__clang__)
+static __thread int tsf_rt_call;
+#  else
+static _Thread_local int tsf_rt_call;
+#  endif
+static void* tsf_rt_malloc(size_t size) { TSF_RT_ASSERT(!tsf_rt_call); return TSF_MALLOC(size); }
+static void* tsf_rt_realloc(void* ptr, size_t size) { TSF_RT_ASSERT(!tsf_rt_call); return TSF_REALLOC(ptr, size); }
+#  undef TSF_MALLOC
+#  undef TSF_REALLOC
+#  define TSF_MALLOC  tsf_rt_malloc
+#  define TSF_REALLOC tsf_rt_realloc
+#  define TSF_RT_ENTER(f) (tsf_rt_call = (f)->realtime)
+#  define TSF_RT_LEAVE() (tsf_rt_call = 0)
+#else
+#  define TSF_RT_ASSERT(x) ((void)0)
+#  define TSF_RT_ENTER(f) ((void)0)
+#  define TSF_RT_LEAVE() ((void)0)
+#endif
+
+#if !defined(TSF_MEMCPY) || !defined(TSF_MEMSET)
+#  include <string.h>
+#  define TSF_MEMCPY  memcpy
+#  define TSF_MEMSET  memset
+#endif
+
+#if !defined(TSF_POW) || !defined(TSF_POWF) || !defined(TSF_EXPF) || !defined(TSF_LOG) || !defined(TSF_TAN) || !defined(TSF_LOG10) || !defined(TSF_SQRT)
+#  include <math.h>
+#  if !defined(__cplusplus) && !defined(NAN) && !defined(powf) && !defined(expf) && !defined(sqrtf)
+#    define powf (float)pow // deal with old math.h
+#    define expf (float)exp // files that come without
+#    define sqrtf (float)sqrt // powf, expf and sqrtf
+#  endif
+#  define TSF_POW     pow
+#  define TSF_POWF    powf
+#  define TSF_EXPF    expf
+#  define TSF_LOG     log
+#  define TSF_TAN     tan
+#  define TSF_LOG10   log10
+#  define TSF_SQRTF   sqrtf
+#endif
+
+#ifndef TSF_NO_STDIO
+#  include <stdio.h>
+#  ifndef TSF_FSEEK
+#    if defined(_MSC_VER)
+#      define TSF_FSEEK   _fseeki64
+#      define TSF_FTELL   _ftelli64
+#      define TSF_FILEOFF __int64
+#    elif defined(__LARGE64_FILES)
+#      define TSF_FSEEK   fseeko64 // newlib, where off_t stays 32 bits
+#      define TSF_FTELL   ftello64
+#      define TSF_FILEOFF _off64_t
+#    else
+#      include <sys/types.h>
+#      define TSF_FSEEK   fseeko
+#      define TSF_FTELL   ftello
+#      define TSF_FILEOFF off_t
+#    endif
+#  endif
+#endif
+
+// Orders the ring buffer reads and writes between the I/O thread and the render thread
+#ifndef TSF_STREAM_BARRIER
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#    define TSF_STREAM_BARRIER() _ReadWriteBarrier()
+#  else
+#    define TSF_STREAM_BARRIER() __sync_synchronize()
+#  endif
+#endif
+
+// Samples per streaming ring buffer (a power of two), the start of the ring is repeated past its end
+// so interpolation can read across the wrap, and the most read into one ring per tsf_stream_update
+#ifndef TSF_STREAM_RING
+#define TSF_STREAM_RING 32768
+#endif
+#define TSF_STREAM_GUARD 64
+#define TSF_STREAM_CHUNK 4096
+
+#if !defined(TSF_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  include <arm_neon.h>
+#  define TSF_SIMD_NEON
+#elif !defined(TSF_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define TSF_SIMD_SSE
+#endif
+
+#if defined(TSF_SAMPLES_SHORT) && defined(STB_VORBIS_INCLUDE_STB_VORBIS_H)
+#  error TSF_SAMPLES_SHORT does not support SF3 (decoded samples are float)
+#endif
+
+#define TSF_TRUE 1
+#define TSF_FALSE 0
+#define TSF_BOOL char
+#define TSF_PI 3.14159265358979323846264338327950288
+#define TSF_NULL 0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef char tsf_fourcc[4];
+typedef signed char tsf_s8;
+typedef unsigned char tsf_u8;
+typedef unsigned short tsf_u16;
+typedef signed short tsf_s16;
+typedef unsigned int tsf_u32;
+typedef long long tsf_s64;
+typedef char tsf_char20[20];
+
+// Sample data as kept in memory. 16-bit samples are scaled to -1..1 as part of the voice gain.
+#ifdef TSF_SAMPLES_SHORT
+typedef tsf_s16 tsf_sample;
+#define TSF_SAMPLE_SCALE (1.0f / 32767.0f)
+#else
+typedef float tsf_sample;
+#define TSF_SAMPLE_SCALE 1.0f
+#endif
+
+#define TSF_FourCCEquals(value1, value2) (value1[0] == value2[0] && value1[1] == value2[1] && value1[2] == value2[2] && value1[3] == value2[3])
+
+// Part of the smpl chunk used by the regions of one sample header, read in when a preset needs it.
+// If streamStart < streamEnd the part between them is streamed, data then ends at streamStart and tail starts at streamEnd.
+struct tsf_samplerange { tsf_u32 start, end, streamStart, streamEnd; tsf_sample *data, *tail; };
+
+// Ring buffer a voice streams the middle of its sample through, positions are relative to the sample range.
+// The render thread takes free rings and retires them, the I/O thread fills them and frees retired ones.
+enum { TSF_STREAM_FREE, TSF_STREAM_PLAYING, TSF_STREAM_RETIRED };
+struct tsf_streamring
+{
+	tsf_sample* ring;
+	tsf_u32 start; // of the sample range, in samples from the start of the smpl chunk
+	tsf_u32 to;
+	volatile tsf_u32 filled, consumed; // written by the I/O thread and the render thread respectively
+	volatile int state;
+};
+
+// Lists of voices used to find the ones a note or channel event affects without scanning all of them.
+// They are linked through the voices by index, in the order voices were added, -1 terminated.
+enum { TSF_VOICELIST_RELEASE, TSF_VOICELIST_KEY, TSF_VOICELIST_CHANNEL, TSF_VOICELIST_GROUP, TSF_VOICELIST_COUNT };
+struct tsf_voice_list { int first, last, count; };
+struct tsf_voice_link { int prev, next; };
+
+// Accumulates the window of tsf_get_stats
+struct tsf_statwindow
+{
+	int peakVoices, stolenVoices, refusedVoices, renderCalls, renderFrames;
+	double renderTicks, voiceFrames;
+	unsigned int maxCallTicks;
+};
+
+struct tsf
+{
+	void* fontData; // presets, regions, preset lookup table and region index in one block, see tsf_fontdata_size
+	struct tsf_preset* presets;
+	struct tsf_region* regions; // of all presets
+	int* presetLookup; // open addressed hash of (bank, preset number) to preset index, -1 for empty
+	unsigned int presetLookupMask;
+	tsf_sample* fontSamples;
+	unsigned int fontSampleNum;
+	TSF_BOOL compiled; // fontSamples are in fontData as well
+	struct tsf_samplerange* sampleRanges; // per sample header, only when loaded paged
+	void* sampleFile; tsf_s64 sampleFileOffset;
+	int sampleRangeNum;
+	struct tsf_streamring* streamRings;
+	int streamRingNum;
+	struct tsf_voice* voices;
+	struct tsf_voice_hot* voiceHot;
+	int* voiceSlots; // voice indices, the first activeVoiceNum are playing and the rest are free
+	struct tsf_channels* channels;
+
+	int presetNum;
+	int voiceNum;
+	int activeVoiceNum;
+	struct tsf_voice_list releaseVoices; // voices in their release, in the order they got there
+	struct tsf_voice_list keyVoices[128]; // playing voices by key, on any channel
+	struct tsf_voice_list groupVoices; // playing voices of regions in an exclusive group
+	int maxVoiceNum;
+	unsigned int voicePlayIndex;
+	TSF_BOOL realtime; // voices and channels are pre-allocated, see tsf_set_realtime
+	struct tsf_statwindow stats;
+
+	enum TSFOutputMode outputmode;
+	float outSampleRate;
+	float globalGainDB;
+	int* refCount;
+};
+
+#ifndef TSF_NO_STDIO
+static int tsf_stream_stdio_read(FILE* f, void* ptr, unsigned int size) { return (int)fread(ptr, 1, size, f); }
+// Fails for positions the C library can't seek to, rather than wrapping around
+static int tsf_file_seek(FILE* f, tsf_s64 pos) { TSF_FILEOFF off = (TSF_FILEOFF)pos; return (pos >= 0 && (tsf_s64)off == pos && !TSF_FSEEK(f, off, SEEK_SET)); }
+static int tsf_stream_stdio_skip(FILE* f, unsigned int count) { TSF_FILEOFF pos = TSF_FTELL(f); return (pos >= 0 && tsf_file_seek(f, (tsf_s64)pos + count)); }
+TSFDEF tsf* tsf_load_filename(const char* filename)
+{
+	tsf* res;
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_stdio_read, (int(*)(void*,unsigned int))&tsf_stream_stdio_skip };
+	#if __STDC_WANT_SECURE_LIB__
+	FILE* f = TSF_NULL; fopen_s(&f, filename, "rb");
+	#else
+	FILE* f = fopen(filename, "rb");
+	#endif
+	if (!f)
+	{
+		//if (e) *e = TSF_FILENOTFOUND;
+		fprintf(stderr, "TSF_FILENOTFOUND\n");
+
+		return TSF_NULL;
+	}
+	stream.data = f;
+	res = tsf_load(&stream);
+	fclose(f);
+	return res;
+}
+#endif
+
+struct tsf_stream_memory { const char* buffer; unsigned int total, pos; };
+static int tsf_stream_memory_read(struct tsf_stream_memory* m, void* ptr, unsigned int size) { if (size > m->total - m->pos) size = m->total - m->pos; TSF_MEMCPY(ptr, m->buffer+m->pos, size); m->pos += size; return size; }
+static int tsf_stream_memory_skip(struct tsf_stream_memory* m, unsigned int count) { if (m->pos + count > m->total) return 0; m->pos += count; return 1; }
+TSFDEF tsf* tsf_load_memory(const void* buffer, int size)
+{
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
+	struct tsf_stream_memory f = { 0, 0, 0 };
+	f.buffer = (const char*)buffer;
+	f.total = size;
+	stream.data = &f;
+	return tsf_load(&stream);
+}
+
+enum { TSF_LOOPMODE_NONE, TSF_LOOPMODE_CONTINUOUS, TSF_LOOPMODE_SUSTAIN };
+
+enum { TSF_SEGMENT_NONE, TSF_SEGMENT_DELAY, TSF_SEGMENT_ATTACK, TSF_SEGMENT_HOLD, TSF_SEGMENT_DECAY, TSF_SEGMENT_SUSTAIN, TSF_SEGMENT_RELEASE, TSF_SEGMENT_DONE };
+
+struct tsf_hydra
+{
+	struct tsf_hydra_phdr *phdrs; struct tsf_hydra_pbag *pbags; struct tsf_hydra_pmod *pmods;
+	struct tsf_hydra_pgen *pgens; struct tsf_hydra_inst *insts; struct tsf_hydra_ibag *ibags;
+	struct tsf_hydra_imod *imods; struct tsf_hydra_igen *igens; struct tsf_hydra_shdr *shdrs;
+	int phdrNum, pbagNum, pmodNum, pgenNum, instNum, ibagNum, imodNum, igenNum, shdrNum;
+};
+
+union tsf_hydra_genamount { struct { tsf_u8 lo, hi; } range; tsf_s16 shortAmount; tsf_u16 wordAmount; };
+struct tsf_hydra_phdr { tsf_char20 presetName; tsf_u16 preset, bank, presetBagNdx; tsf_u32 library, genre, morphology; };
+struct tsf_hydra_pbag { tsf_u16 genNdx, modNdx; };
+struct tsf_hydra_pmod { tsf_u16 modSrcOper, modDestOper; tsf_s16 modAmount; tsf_u16 modAmtSrcOper, modTransOper; };
+struct tsf_hydra_pgen { tsf_u16 genOper; union tsf_hydra_genamount genAmount; };
+struct tsf_hydra_inst { tsf_char20 instName; tsf_u16 instBagNdx; };
+struct tsf_hydra_ibag { tsf_u16 instGenNdx, instModNdx; };
+struct tsf_hydra_imod { tsf_u16 modSrcOper, modDestOper; tsf_s16 modAmount; tsf_u16 modAmtSrcOper, modTransOper; };
+struct tsf_hydra_igen { tsf_u16 genOper; union tsf_hydra_genamount genAmount; };
+struct tsf_hydra_shdr { tsf_char20 sampleName; tsf_u32 start, end, startLoop, endLoop, sampleRate; tsf_u8 originalPitch; tsf_s8 pitchCorrection; tsf_u16 sampleLink, sampleType; };
+
+// Records are decoded from a whole sub-chunk read into memory, p is advanced past each field
+#define TSFR(FIELD) TSF_MEMCPY(&i->FIELD, *p, sizeof(i->FIELD)); *p += sizeof(i->FIELD);
+static void tsf_hydra_read_phdr(struct tsf_hydra_phdr* i, const char** p) { TSFR(presetName) TSFR(preset) TSFR(bank) TSFR(presetBagNdx) TSFR(library) TSFR(genre) TSFR(morphology) }
+static void tsf_hydra_read_pbag(struct tsf_hydra_pbag* i, const char** p) { TSFR(genNdx) TSFR(modNdx) }
+static void tsf_hydra_read_pmod(struct tsf_hydra_pmod* i, const char** p) { TSFR(modSrcOper) TSFR(modDestOper) TSFR(modAmount) TSFR(modAmtSrcOper) TSFR(modTransOper) }
+static void tsf_hydra_read_pgen(struct tsf_hydra_pgen* i, const char** p) { TSFR(genOper) TSFR(genAmount) }
+static void tsf_hydra_read_inst(struct tsf_hydra_inst* i, const char** p) { TSFR(instName) TSFR(instBagNdx) }
+static void tsf_hydra_read_ibag(struct tsf_hydra_ibag* i, const char** p) { TSFR(instGenNdx) TSFR(instModNdx) }
+static void tsf_hydra_read_imod(struct tsf_hydra_imod* i, const char** p) { TSFR(modSrcOper) TSFR(modDestOper) TSFR(modAmount) TSFR(modAmtSrcOper) TSFR(modTransOper) }
+static void tsf_hydra_read_igen(struct tsf_hydra_igen* i, const char** p) { TSFR(genOper) TSFR(genAmount) }
+static void tsf_hydra_read_shdr(struct tsf_hydra_shdr* i, const char** p) { TSFR(sampleName) TSFR(start) TSFR(end) TSFR(startLoop) TSFR(endLoop) TSFR(sampleRate) TSFR(originalPitch) TSFR(pitchCorrection) TSFR(sampleLink) TSFR(sampleType) }
+#undef TSFR
+
+struct tsf_riffchunk { tsf_fourcc id; tsf_u32 size; };
+struct tsf_envelope { float delay, attack, hold, decay, sustain, release, keynumToHold, keynumToDecay; };
+struct tsf_voice_envelope { float level, slope; int samplesUntilNextSegment; short segment, midiVelocity; struct tsf_envelope parameters; TSF_BOOL segmentIsExponential, isAmpEnv; };
+struct tsf_voice_lowpass { float QInv, a0, a1, b1, b2, z1, z2; TSF_BOOL active; };
+struct tsf_voice_lfo { int samplesUntil; float level, delta; };
+
+struct tsf_region
+{
+	int loop_mode;
+	unsigned int sample_rate;
+	unsigned char lokey, hikey, lovel, hivel;
+	unsigned int group, offset, end, loop_start, loop_end;
+	int transpose, tune, pitch_keycenter, pitch_keytrack;
+	float attenuation, pan;
+	struct tsf_envelope ampenv, modenv;
+	int initialFilterQ, initialFilterFc;
+	int modEnvToPitch, modEnvToFilterFc, modLfoToFilterFc, modLfoToVolume;
+	float delayModLFO;
+	int freqModLFO, modLfoToPitch;
+	float delayVibLFO;
+	int freqVibLFO, vibLfoToPitch;
+	int sampleIndex;
+};
+
+struct tsf_preset
+{
+	tsf_char20 presetName;
+	tsf_u16 preset, bank;
+	struct tsf_region* regions;
+	int regionNum;
+
+	// Regions by key and velocity band, all in the block keyBands points to. The bands of a key start at
+	// keyBands[key] and go up in velocity, each covering up to bandHivel[band] with the last one up to 127
+	// (keys playing the same regions share them). Their region indices are in regionList from
+	// bandStart[band] up to bandStart[band + 1].
+	int *keyBands, *bandHivel, *bandStart, *regionList;
+};
+
+// Voice bookkeeping used by note and channel handling.
+// Slots are shared with f->voiceHot, activeIndex is the voice's place in f->voiceSlots while it plays.
+struct tsf_voice
+{
+	int playingPreset, playingKey, playingChannel, heldSustain, activeIndex;
+	struct tsf_region* region;
+	unsigned int playIndex;
+	struct tsf_voice_link links[TSF_VOICELIST_COUNT];
+	unsigned char linked; // bit per list the voice is in
+};
+
+// Everything the render loop needs for a voice, including what used to be looked up in
+// the region on every render call, so rendering touches only these records.
+struct tsf_voice_hot
+{
+	double pitchRatio, pitchInputTimecents, pitchOutputFactor;
+	const tsf_sample* samples; // what phaseInt, sampleEnd and the loop positions index into
+	int stream; // ring streaming the sample from streamStart to streamEnd and tail after it, or -1
+	const tsf_sample* tail;
+	unsigned int streamStart, streamEnd;
+	float  noteGainDB, noteGain, panFactorLeft, panFactorRight;
+	float  initialFilterFc, modLfoToFilterFc, modEnvToFilterFc, modLfoToPitch, vibLfoToPitch, modEnvToPitch, modLfoToVolume;
+	unsigned int phaseInt, phaseFrac; // sample position in 32.32 fixed point, see tsf_voice_interpolate
+	unsigned int sampleEnd, loopStart, loopEnd;
+	TSF_BOOL updateModEnv, updateModLFO, updateVibLFO, dynamicLowpass, dynamicPitchRatio, dynamicGain;
+	struct tsf_voice_envelope ampenv, modenv;
+	struct tsf_voice_lowpass lowpass;
+	struct tsf_voice_lfo modlfo, viblfo;
+};
+
+// Channel changes the voices haven't seen yet, applied by tsf_channels_apply
+enum { TSF_CHANNEL_DIRTY_PITCH = 1, TSF_CHANNEL_DIRTY_PAN = 2, TSF_CHANNEL_DIRTY_GAIN = 4 };
+
+struct tsf_channel
+{
+	unsigned short presetIndex, bank, pitchWheel, midiPan, midiVolume, midiExpression, midiRPN, midiData, sustain;
+	float panOffset, gainDB, pitchRange, tuning;
+	float appliedGainDB; // the gainDB playing voices have, until a pending volume change is applied
+	unsigned char dirty; // TSF_CHANNEL_DIRTY_* flags
+	struct tsf_voice_list voices;
+};
+
+struct tsf_channels
+{
+	void (*setupVoice)(tsf* f, struct tsf_voice* voice);
+	int channelNum, activeChannel;
+	TSF_BOOL dirty; // some channel has changes waiting for the next render
+	struct tsf_channel channels[1];
+};
+
+static double tsf_timecents2Secsd(double timecents) { return TSF_POW(2.0, timecents / 1200.0); }
+static float tsf_timecents2Secsf(float timecents) { return TSF_POWF(2.0f, timecents / 1200.0f); }
+static float tsf_cents2Hertz(float cents) { return 8.176f * TSF_POWF(2.0f, cents / 1200.0f); }
+static float tsf_decibelsToGain(float db) { return (db > -100.f ? TSF_POWF(10.0f, db * 0.05f) : 0); }
+static float tsf_gainToDecibels(float gain) { return (gain <= .00001f ? -100.f : (float)(20.0 * TSF_LOG10(gain))); }
+
+static TSF_BOOL tsf_riffchunk_read(struct tsf_riffchunk* parent, struct tsf_riffchunk* chunk, struct tsf_stream* stream)
+{
+	TSF_BOOL IsRiff, IsList;
+	if (parent && sizeof(tsf_fourcc) + sizeof(tsf_u32) > parent->size) return TSF_FALSE;
+	if (!stream->read(stream->data, &chunk->id, sizeof(tsf_fourcc)) || *chunk->id <= ' ' || *chunk->id >= 'z') return TSF_FALSE;
+	if (!stream->read(stream->data, &chunk->size, sizeof(tsf_u32))) return TSF_FALSE;
+	if (parent && sizeof(tsf_fourcc) + sizeof(tsf_u32) + chunk->size > parent->size) return TSF_FALSE;
+	if (parent) parent->size -= sizeof(tsf_fourcc) + sizeof(tsf_u32) + chunk->size;
+	IsRiff = TSF_FourCCEquals(chunk->id, "RIFF"), IsList = TSF_FourCCEquals(chunk->id, "LIST");
+	if (IsRiff && parent) return TSF_FALSE; //not allowed
+	if (!IsRiff && !IsList) return TSF_TRUE; //custom type without sub type
+	if (!stream->read(stream->data, &chunk->id, sizeof(tsf_fourcc)) || *chunk->id <= ' ' || *chunk->id >= 'z') return TSF_FALSE;
+	chunk->size -= sizeof(tsf_fourcc);
+	return TSF_TRUE;
+}
+
+static void tsf_region_clear(struct tsf_region* i, TSF_BOOL for_relative)
+{
+	TSF_MEMSET(i, 0, sizeof(struct tsf_region));
+	i->hikey = i->hivel = 127;
+	i->pitch_keycenter = 60; // C4
+	if (for_relative) return;
+
+	i->pitch_keytrack = 100;
+
+	i->pitch_keycenter = -1;
+
+	// SF2 defaults in timecents.
+	i->ampenv.delay = i->ampenv.attack = i->ampenv.hold = i->ampenv.decay = i->ampenv.release = -12000.0f;
+	i->modenv.delay = i->modenv.attack = i->modenv.hold = i->modenv.decay = i->modenv.release = -12000.0f;
+
+	i->initialFilterFc = 13500;
+
+	i->delayModLFO = -12000.0f;
+	i->delayVibLFO = -12000.0f;
+}
+
+static void tsf_region_operator(struct tsf_region* region, tsf_u16 genOper, union tsf_hydra_genamount* amount, struct tsf_region* merge_region)
+{
+	enum
+	{
+		_GEN_TYPE_MASK       = 0x0F,
+		GEN_FLOAT            = 0x01,
+		GEN_INT              = 0x02,
+		GEN_UINT_ADD         = 0x03,
+		GEN_UINT_ADD15       = 0x04,
+		GEN_KEYRANGE         = 0x05,
+		GEN_VELRANGE         = 0x06,
+		GEN_LOOPMODE         = 0x07,
+		GEN_GROUP            = 0x08,
+		GEN_KEYCENTER        = 0x09,
+
+		_GEN_LIMIT_MASK      = 0xF0,
+		GEN_INT_LIMIT12K     = 0x10, //min -12000, max 12000
+		GEN_INT_LIMITFC      = 0x20, //min 1500, max 13500
+		GEN_INT_LIMITQ       = 0x30, //min 0, max 960
+		GEN_INT_LIMIT960     = 0x40, //min -960, max 960
+		GEN_INT_LIMIT16K4500 = 0x50, //min -16000, max 4500
+		GEN_FLOAT_LIMIT12K5K = 0x60, //min -12000, max 5000
+		GEN_FLOAT_LIMIT12K8K = 0x70, //min -12000, max 8000
+		GEN_FLOAT_LIMIT1200  = 0x80, //min -1200, max 1200
+		GEN_FLOAT_LIMITPAN   = 0x90, //* .001f, min -.5f, max .5f,
+		GEN_FLOAT_LIMITATTN  = 0xA0, //* .1f, min 0, max 144.0
+		GEN_FLOAT_MAX1000    = 0xB0, //min 0, max 1000
+		GEN_FLOAT_MAX1440    = 0xC0, //min 0, max 1440
+
+		_GEN_MAX = 59
+	};
+	#define _TSFREGIONOFFSET(TYPE, FIELD) (unsigned char)(((TYPE*)&((struct tsf_region*)0)->FIELD) - (TYPE*)0)
+	#define _TSFREGIONENVOFFSET(TYPE, ENV, FIELD) (unsigned char)(((TYPE*)&((&(((struct tsf_region*)0)->ENV))->FIELD)) - (TYPE*)0)
+	static const struct { unsigned char mode, offset; } genMetas[_GEN_MAX] =
+	{
+		{ GEN_UINT_ADD                     , _TSFREGIONOFFSET(unsigned int, offset               ) }, // 0 StartAddrsOffset
+		{ GEN_UINT_ADD                     , _TSFREGIONOFFSET(unsigned int, end                  ) }, // 1 EndAddrsOffset
+		{ GEN_UINT_ADD                     , _TSFREGIONOFFSET(unsigned int, loop_start           ) }, // 2 StartloopAddrsOffset
+		{ GEN_UINT_ADD                     , _TSFREGIONOFFSET(unsigned int, loop_end             ) }, // 3 EndloopAddrsOffset
+		{ GEN_UINT_ADD15                   , _TSFREGIONOFFSET(unsigned int, offset               ) }, // 4 StartAddrsCoarseOffset
+		{ GEN_INT   | GEN_INT_LIMIT12K     , _TSFREGIONOFFSET(         int, modLfoToPitch        ) }, // 5 ModLfoToPitch
+		{ GEN_INT   | GEN_INT_LIMIT12K     , _TSFREGIONOFFSET(         int, vibLfoToPitch        ) }, // 6 VibLfoToPitch
+		{ GEN_INT   | GEN_INT_LIMIT12K     , _TSFREGIONOFFSET(         int, modEnvToPitch        ) }, // 7 ModEnvToPitch
+		{ GEN_INT   | GEN_INT_LIMITFC      , _TSFREGIONOFFSET(         int, initialFilterFc      ) }, // 8 InitialFilterFc
+		{ GEN_INT   | GEN_INT_LIMITQ       , _TSFREGIONOFFSET(         int, initialFilterQ       ) }, // 9 InitialFilterQ
+		{ GEN_INT   | GEN_INT_LIMIT12K     , _TSFREGIONOFFSET(         int, modLfoToFilterFc     ) }, //10 ModLfoToFilterFc
+		{ GEN_INT   | GEN_INT_LIMIT12K     , _TSFREGIONOFFSET(         int, modEnvToFilterFc     ) }, //11 ModEnvToFilterFc
+		{ GEN_UINT_ADD15                   , _TSFREGIONOFFSET(unsigned int, end                  ) }, //12 EndAddrsCoarseOffset
+		{ GEN_INT   | GEN_INT_LIMIT960     , _TSFREGIONOFFSET(         int, modLfoToVolume       ) }, //13 ModLfoToVolume
+		{ 0                                , (0                                                  ) }, //   Unused
+		{ 0                                , (0                                                  ) }, //15 ChorusEffectsSend (unsupported)
+		{ 0                                , (0                                                  ) }, //16 ReverbEffectsSend (unsupported)
+		{ GEN_FLOAT | GEN_FLOAT_LIMITPAN   , _TSFREGIONOFFSET(       float, pan                  ) }, //17 Pan
+		{ 0                                , (0                                                  ) }, //   Unused
+		{ 0                                , (0                                                  ) }, //   Unused
+		{ 0                                , (0                                                  ) }, //   Unused
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONOFFSET(       float, delayModLFO          ) }, //21 DelayModLFO
+		{ GEN_INT   | GEN_INT_LIMIT16K4500 , _TSFREGIONOFFSET(         int, freqModLFO           ) }, //22 FreqModLFO
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONOFFSET(       float, delayVibLFO          ) }, //23 DelayVibLFO
+		{ GEN_INT   | GEN_INT_LIMIT16K4500 , _TSFREGIONOFFSET(         int, freqVibLFO           ) }, //24 FreqVibLFO
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONENVOFFSET(    float, modenv, delay        ) }, //25 DelayModEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, modenv, attack       ) }, //26 AttackModEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONENVOFFSET(    float, modenv, hold         ) }, //27 HoldModEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, modenv, decay        ) }, //28 DecayModEnv
+		{ GEN_FLOAT | GEN_FLOAT_MAX1000    , _TSFREGIONENVOFFSET(    float, modenv, sustain      ) }, //29 SustainModEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, modenv, release      ) }, //30 ReleaseModEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT1200  , _TSFREGIONENVOFFSET(    float, modenv, keynumToHold ) }, //31 KeynumToModEnvHold
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT1200  , _TSFREGIONENVOFFSET(    float, modenv, keynumToDecay) }, //32 KeynumToModEnvDecay
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONENVOFFSET(    float, ampenv, delay        ) }, //33 DelayVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, ampenv, attack       ) }, //34 AttackVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K5K , _TSFREGIONENVOFFSET(    float, ampenv, hold         ) }, //35 HoldVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, ampenv, decay        ) }, //36 DecayVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_MAX1440    , _TSFREGIONENVOFFSET(    float, ampenv, sustain      ) }, //37 SustainVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT12K8K , _TSFREGIONENVOFFSET(    float, ampenv, release      ) }, //38 ReleaseVolEnv
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT1200  , _TSFREGIONENVOFFSET(    float, ampenv, keynumToHold ) }, //39 KeynumToVolEnvHold
+		{ GEN_FLOAT | GEN_FLOAT_LIMIT1200  , _TSFREGIONENVOFFSET(    float, ampenv, keynumToDecay) }, //40 KeynumToVolEnvDecay
+		{ 0                                , (0                                                  ) }, //   Instrument (special)
+		{ 0                                , (0                                                  ) }, //   Reserved
+		{ GEN_KEYRANGE                     , (0                                                  ) }, //43 KeyRange
+		{ GEN_VELRANGE                     , (0                                                  ) }, //44 VelRange
+		{ GEN_UINT_ADD15                   , _TSFREGIONOFFSET(unsigned int, loop_start           ) }, //45 StartloopAddrsCoarseOffset
+		{ 0                                , (0                                                  ) }, //46 Keynum (special)
+		{ 0                                , (0                                                  ) }, //47 Velocity (special)
+		{ GEN_FLOAT | GEN_FLOAT_LIMITATTN  , _TSFREGIONOFFSET(       float, attenuation          ) }, //48 InitialAttenuation
+		{ 0                                , (0                                                  ) }, //   Reserved
+		{ GEN_UINT_ADD15                   , _TSFREGIONOFFSET(unsigned int, loop_end             ) }, //50 EndloopAddrsCoarseOffset
+		{ GEN_INT                          , _TSFREGIONOFFSET(         int, transpose            ) }, //51 CoarseTune
+		{ GEN_INT                          , _TSFREGIONOFFSET(         int, tune                 ) }, //52 FineTune
+		{ 0                                , (0                                                  ) }, //   SampleID (special)
+		{ GEN_LOOPMODE                     , _TSFREGIONOFFSET(         int, loop_mode            ) }, //54 SampleModes
+		{ 0                                , (0                                                  ) }, //   Reserved
+		{ GEN_INT                          , _TSFREGIONOFFSET(         int, pitch_keytrack       ) }, //56 ScaleTuning
+		{ GEN_GROUP                        , _TSFREGIONOFFSET(unsigned int, group                ) }, //57 ExclusiveClass
+		{ GEN_KEYCENTER                    , _TSFREGIONOFFSET(         int, pitch_keycenter      ) }, //58 OverridingRootKey
+	};
+	#undef _TSFREGIONOFFSET
+	#undef _TSFREGIONENVOFFSET
+	if (amount)
+	{
+		int offset;
+		if (genOper >= _GEN_MAX) return;
+		offset = genMetas[genOper].offset;
+		switch (genMetas[genOper].mode & _GEN_TYPE_MASK)
+		{
+			case GEN_FLOAT:      ((       float*)region)[offset]  = amount->shortAmount;     return;
+			case GEN_INT:        ((         int*)region)[offset]  = amount->shortAmount;     return;
+			case GEN_UINT_ADD:   ((unsigned int*)region)[offset] += amount->shortAmount;     return;
+			case GEN_UINT_ADD15: ((unsigned int*)region)[offset] += amount->shortAmount<<15; return;
+			case GEN_KEYRANGE:   region->lokey = amount->range.lo; region->hikey = amount->range.hi; return;
+			case GEN_VELRANGE:   region->lovel = amount->range.lo; region->hivel = amount->range.hi; return;
+			case GEN_LOOPMODE:   region->loop_mode       = ((amount->wordAmount&3) == 3 ? TSF_LOOPMODE_SUSTAIN : ((amount->wordAmount&3) == 1 ? TSF_LOOPMODE_CONTINUOUS : TSF_LOOPMODE_NONE)); return;
+			case GEN_GROUP:      region->group           = amount->wordAmount;  return;
+			case GEN_KEYCENTER:  region->pitch_keycenter = amount->shortAmount; return;
+		}
+	}
+	else //merge regions and clamp values
+	{
+		for (genOper = 0; genOper != _GEN_MAX; genOper++)
+		{
+			int offset = genMetas[genOper].offset;
+			switch (genMetas[genOper].mode & _GEN_TYPE_MASK)
+			{
+				case GEN_FLOAT:
+				{
+					float *val = &((float*)region)[offset], vfactor, vmin, vmax;
+					*val += ((float*)merge_region)[offset];
+					switch (genMetas[genOper].mode & _GEN_LIMIT_MASK)
+					{
+						case GEN_FLOAT_LIMIT12K5K: vfactor =   1.0f; vmin = -12000.0f; vmax = 5000.0f; break;
+						case GEN_FLOAT_LIMIT12K8K: vfactor =   1.0f; vmin = -12000.0f; vmax = 8000.0f; break;
+						case GEN_FLOAT_LIMIT1200:  vfactor =   1.0f; vmin =  -1200.0f; vmax = 1200.0f; break;
+						case GEN_FLOAT_LIMITPAN:   vfactor = 0.001f; vmin =     -0.5f; vmax =    0.5f; break;
+						case GEN_FLOAT_LIMITATTN:  vfactor =   0.1f; vmin =      0.0f; vmax =  144.0f; break;
+						case GEN_FLOAT_MAX1000:    vfactor =   1.0f; vmin =      0.0f; vmax = 1000.0f; break;
+						case GEN_FLOAT_MAX1440:    vfactor =   1.0f; vmin =      0.0f; vmax = 1440.0f; break;
+						default: continue;
+					}
+					*val *= vfactor;
+					if      (*val < vmin) *val = vmin;
+					else if (*val > vmax) *val = vmax;
+					continue;
+				}
+				case GEN_INT:
+				{
+					int *val = &((int*)region)[offset], vmin, vmax;
+					*val += ((int*)merge_region)[offset];
+					switch (genMetas[genOper].mode & _GEN_LIMIT_MASK)
+					{
+						case GEN_INT_LIMIT12K:     vmin = -12000; vmax = 12000; break;
+						case GEN_INT_LIMITFC:      vmin =   1500; vmax = 13500; break;
+						case GEN_INT_LIMITQ:       vmin =      0; vmax =   960; break;
+						case GEN_INT_LIMIT960:     vmin =   -960; vmax =   960; break;
+						case GEN_INT_LIMIT16K4500: vmin = -16000; vmax =  4500; break;
+						default: continue;
+					}
+					if      (*val < vmin) *val = vmin;
+					else if (*val > vmax) *val = vmax;
+					continue;
+				}
+				case GEN_UINT_ADD:
+				{
+					((unsigned int*)region)[offset] += ((unsigned int*)merge_region)[offset];
+					continue;
+				}
+			}
+		}
+	}
+}
+
+static void tsf_region_envtosecs(struct tsf_envelope* p, TSF_BOOL sustainIsGain)
+{
+	// EG times need to be converted from timecents to seconds.
+	// Pin very short EG segments.  Timecents don't get to zero, and our EG is
+	// happier with zero values.
+	p->delay   = (p->delay   < -11950.0f ? 0.0f : tsf_timecents2Secsf(p->delay));
+	p->attack  = (p->attack  < -11950.0f ? 0.0f : tsf_timecents2Secsf(p->attack));
+	p->release = (p->release < -11950.0f ? 0.0f : tsf_timecents2Secsf(p->release));
+
+	// If we have dynamic hold or decay times depending on key number we need
+	// to keep the values in timecents so we can calculate it during startNote
+	if (!p->keynumToHold)  p->hold  = (p->hold  < -11950.0f ? 0.0f : tsf_timecents2Secsf(p->hold));
+	if (!p->keynumToDecay) p->decay = (p->decay < -11950.0f ? 0.0f : tsf_timecents2Secsf(p->decay));
+
+	if (p->sustain < 0.0f) p->sustain = 0.0f;
+	else if (sustainIsGain) p->sustain = tsf_decibelsToGain(-p->sustain / 10.0f);
+	else p->sustain = 1.0f - (p->sustain / 1000.0f);
+}
+
+#define TSF_PRESET_KEY(phdr) (((tsf_u32)(phdr).bank << 16) | (phdr).preset)
+#define TSF_PRESET_HASH(bank, preset_number) ((((unsigned int)(bank) << 16) | (unsigned int)(preset_number)) * 2654435761u >> 8)
+
+// Number of entries in the preset lookup table, a power of two keeping it at most half full
+static unsigned int tsf_presetlookup_size(int presetNum)
+{
+	unsigned int size = 16;
+	while (size < (unsigned int)presetNum * 2) size <<= 1;
+	return size;
+}
+
+// A loaded font's presets, regions, preset lookup table and region index share one block, in that order
+// (compiled fonts have their samples after it). Sizes are in entries of each.
+static size_t tsf_fontdata_size(int presetNum, int regionNum, unsigned int lookupNum, size_t indexNum)
+{
+	return presetNum * sizeof(struct tsf_preset) + regionNum * sizeof(struct tsf_region) + (lookupNum + indexNum) * sizeof(int);
+}
+
+// Points the presets, regions and preset lookup table into fontData, returns where the region index starts
+static int* tsf_fontdata_place(tsf* res, int regionNum)
+{
+	res->presets = (struct tsf_preset*)res->fontData;
+	res->regions = (struct tsf_region*)(res->presets + res->presetNum);
+	res->presetLookup = (int*)(res->regions + regionNum);
+	return res->presetLookup + res->presetLookupMask + 1;
+}
+
+// Fills the hash table tsf_get_presetindex looks presets up in.
+// Presets are sorted so inserting in order keeps the first of any duplicates, like a linear search would find.
+static void tsf_load_presetlookup(tsf* res)
+{
+	unsigned int size = res->presetLookupMask + 1, i;
+	int preset_index;
+	for (i = 0; i != size; i++) res->presetLookup[i] = -1;
+	for (preset_index = 0; preset_index != res->presetNum; preset_index++)
+	{
+		const struct tsf_preset* preset = &res->presets[preset_index];
+		if (preset_index && preset->bank == preset[-1].bank && preset->preset == preset[-1].preset) continue;
+		for (i = TSF_PRESET_HASH(preset->bank, preset->preset) & res->presetLookupMask; res->presetLookup[i] != -1; i = (i + 1) & res->presetLookupMask) {}
+		res->presetLookup[i] = preset_index;
+	}
+}
+
+// Indexes the regions of each preset by key and velocity band. The bands of a key split the
+// velocities wherever the range of a region on that key starts or ends, so every velocity in a band
+// plays the same regions. Two passes over the same steps, the first one only counts so fontData can
+// grow once to hold the index of all presets.
+static int tsf_load_regionindex(tsf* res)
+{
+	enum { LOKEY, HIKEY, LOVEL, HIVEL };
+	struct tsf_preset *preset, *presetEnd;
+	int *covering, *counts, *index = TSF_NULL, maxRegionNum = 1, regionTotal = 0, pass;
+	size_t indexNum = 0;
+	unsigned char (*ranges)[4];
+	for (preset = res->presets, presetEnd = preset + res->presetNum; preset != presetEnd; preset++)
+	{
+		if (preset->regionNum > maxRegionNum) maxRegionNum = preset->regionNum;
+		regionTotal += preset->regionNum;
+	}
+	// Regions on the current key, band and list counts of each preset from the first pass
+	// and a compact copy of the key and velocity ranges of a preset
+	covering = (int*)TSF_MALLOC((maxRegionNum + res->presetNum * 2) * sizeof(int) + maxRegionNum * 4);
+	if (!covering) return 0;
+	counts = covering + maxRegionNum;
+	ranges = (unsigned char(*)[4])(counts + res->presetNum * 2);
+	for (pass = 0; pass != 2; pass++)
+	{
+		if (pass)
+		{
+			struct tsf_region* regions;
+			void* fontData = TSF_REALLOC(res->fontData, tsf_fontdata_size(res->presetNum, regionTotal, res->presetLookupMask + 1, indexNum));
+			if (!fontData) { TSF_FREE(covering); return 0; }
+			res->fontData = fontData;
+			index = tsf_fontdata_place(res, regionTotal);
+			for (preset = res->presets, presetEnd = preset + res->presetNum, regions = res->regions; preset != presetEnd; preset++)
+				preset->regions = regions, regions += preset->regionNum;
+		}
+		for (preset = res->presets; preset != presetEnd; preset++)
+		{
+			unsigned char keyChange[128];
+			int key, bandNum = 0, listNum = 0, *presetCounts = counts + (preset - res->presets) * 2, i;
+			if (pass)
+			{
+				preset->keyBands = index;
+				preset->bandHivel = index + 128;
+				preset->bandStart = preset->bandHivel + presetCounts[0];
+				preset->regionList = preset->bandStart + presetCounts[0] + 1;
+				preset->bandStart[presetCounts[0]] = presetCounts[1];
+				index = preset->regionList + presetCounts[1];
+			}
+
+			// Keys where a region starts or ends, the ones in between play the same regions as the key before
+			TSF_MEMSET(keyChange, 0, sizeof(keyChange));
+			keyChange[0] = 1;
+			for (i = 0; i != preset->regionNum; i++)
+			{
+				struct tsf_region* region = &preset->regions[i];
+				ranges[i][LOKEY] = region->lokey, ranges[i][HIKEY] = region->hikey;
+				ranges[i][LOVEL] = region->lovel, ranges[i][HIVEL] = (region->hivel < 127 ? region->hivel : 127);
+				if (region->lovel > region->hivel || region->lovel > 127) ranges[i][LOKEY] = 255; // never plays
+				if (region->lokey <= 127) keyChange[region->lokey] = 1;
+				if (region->hikey < 127) keyChange[region->hikey + 1] = 1;
+			}
+
+			for (key = 0; key != 128; key++)
+			{
+				unsigned char bounds[128];
+				int boundNum = 1, coverNum = 0, j;
+				if (!keyChange[key])
+				{
+					if (pass) preset->keyBands[key] = preset->keyBands[key - 1];
+					continue;
+				}
+				for (i = 0; i != preset->regionNum; i++)
+					if (key >= ranges[i][LOKEY] && key <= ranges[i][HIKEY]) covering[coverNum++] = i;
+
+				// Sorted velocities where bands start
+				bounds[0] = 0;
+				for (i = 0; i != coverNum; i++)
+				{
+					int edges[2], edgeNum = 0, e, k;
+					edges[edgeNum++] = ranges[covering[i]][LOVEL];
+					if (ranges[covering[i]][HIVEL] < 127) edges[edgeNum++] = ranges[covering[i]][HIVEL] + 1;
+					for (e = 0; e != edgeNum; e++)
+					{
+						for (j = 0; j != boundNum && bounds[j] < edges[e]; j++) {}
+						if (j != boundNum && bounds[j] == edges[e]) continue;
+						for (k = boundNum++; k != j; k--) bounds[k] = bounds[k - 1];
+						bounds[j] = (unsigned char)edges[e];
+					}
+				}
+
+				if (pass) preset->keyBands[key] = bandNum;
+				for (j = 0; j != boundNum; j++, bandNum++)
+				{
+					int lo = bounds[j], hi = (j + 1 != boundNum ? bounds[j + 1] - 1 : 127);
+					if (pass) preset->bandHivel[bandNum] = hi, preset->bandStart[bandNum] = listNum;
+					for (i = 0; i != coverNum; i++)
+					{
+						if (ranges[covering[i]][LOVEL] > lo || ranges[covering[i]][HIVEL] < hi) continue;
+						if (pass) preset->regionList[listNum] = covering[i];
+						listNum++;
+					}
+				}
+			}
+			if (!pass)
+			{
+				presetCounts[0] = bandNum, presetCounts[1] = listNum;
+				indexNum += 128 + bandNum * 2 + 1 + listNum;
+			}
+		}
+	}
+	TSF_FREE(covering);
+	return 1;
+}
+
+// Returns the preset headers' indices ordered by bank and preset number, equal ones in file order.
+// A bottom-up merge sort, which is stable and doesn't need the C library.
+static int* tsf_sort_presets(const struct tsf_hydra_phdr* phdrs, int num)
+{
+	int *order = (int*)TSF_MALLOC((num ? num : 1) * 2 * sizeof(int)), *tmp = order + num, width, i;
+	if (!order) return TSF_NULL;
+	for (i = 0; i != num; i++) order[i] = i;
+	for (width = 1; width < num; width *= 2)
+	{
+		for (i = 0; i < num; i += width * 2)
+		{
+			int a = i, aEnd = (i + width < num ? i + width : num), b = aEnd, bEnd = (i + width * 2 < num ? i + width * 2 : num), out = i;
+			while (a != aEnd && b != bEnd)
+				tmp[out++] = (TSF_PRESET_KEY(phdrs[order[b]]) < TSF_PRESET_KEY(phdrs[order[a]]) ? order[b++] : order[a++]);
+			while (a != aEnd) tmp[out++] = order[a++];
+			while (b != bEnd) tmp[out++] = order[b++];
+		}
+		TSF_MEMCPY(order, tmp, num * sizeof(int));
+	}
+	return order;
+}
+
+static int tsf_load_presets(tsf* res, struct tsf_hydra *hydra, unsigned int fontSampleCount)
+{
+	enum { GenInstrument = 41, GenKeyRange = 43, GenVelRange = 44, GenSampleID = 53 };
+	struct tsf_hydra_phdr *pphdr;
+	struct tsf_preset* preset;
+	struct tsf_region* regions;
+	int sortedIndex, regionTotal = 0, *order, *regionNums;
+	res->presetNum = hydra->phdrNum - 1;
+	order = tsf_sort_presets(hydra->phdrs, res->presetNum);
+	if (!order) return 0;
+	regionNums = order + res->presetNum; // the sort's scratch space, free again
+
+	// Count the regions of every preset first so the presets and all their regions can go into one block
+	for (sortedIndex = 0; sortedIndex != res->presetNum; sortedIndex++)
+	{
+		struct tsf_hydra_pbag *ppbag, *ppbagEnd;
+		int regionNum = 0;
+		pphdr = &hydra->phdrs[order[sortedIndex]];
+
+		//count regions covered by this preset
+		for (ppbag = hydra->pbags + pphdr->presetBagNdx, ppbagEnd = hydra->pbags + pphdr[1].presetBagNdx; ppbag != ppbagEnd; ppbag++)
+		{
+			unsigned char plokey = 0, phikey = 127, plovel = 0, phivel = 127;
+			struct tsf_hydra_pgen *ppgen, *ppgenEnd; struct tsf_hydra_inst *pinst; struct tsf_hydra_ibag *pibag, *pibagEnd; struct tsf_hydra_igen *pigen, *pigenEnd;
+			for (ppgen = hydra->pgens + ppbag->genNdx, ppgenEnd = hydra->pgens + ppbag[1].genNdx; ppgen != ppgenEnd; ppgen++)
+			{
+				if (ppgen->genOper == GenKeyRange) { plokey = ppgen->genAmount.range.lo; phikey = ppgen->genAmount.range.hi; continue; }
+				if (ppgen->genOper == GenVelRange) { plovel = ppgen->genAmount.range.lo; phivel = ppgen->genAmount.range.hi; continue; }
+				if (ppgen->genOper != GenInstrument) continue;
+				if (ppgen->genAmount.wordAmount >= hydra->instNum) continue;
+				pinst = hydra->insts + ppgen->genAmount.wordAmount;
+				for (pibag = hydra->ibags + pinst->instBagNdx, pibagEnd = hydra->ibags + pinst[1].instBagNdx; pibag != pibagEnd; pibag++)
+				{
+					unsigned char ilokey = 0, ihikey = 127, ilovel = 0, ihivel = 127;
+					for (pigen = hydra->igens + pibag->instGenNdx, pigenEnd = hydra->igens + pibag[1].instGenNdx; pigen != pigenEnd; pigen++)
+					{
+						if (pigen->genOper == GenKeyRange) { ilokey = pigen->genAmount.range.lo; ihikey = pigen->genAmount.range.hi; continue; }
+						if (pigen->genOper == GenVelRange) { ilovel = pigen->genAmount.range.lo; ihivel = pigen->genAmount.range.hi; continue; }
+						if (pigen->genOper == GenSampleID && ihikey >= plokey && ilokey <= phikey && ihivel >= plovel && ilovel <= phivel) regionNum++;
+					}
+				}
+			}
+		}
+		regionNums[sortedIndex] = regionNum;
+		regionTotal += regionNum;
+	}
+
+	res->presetLookupMask = tsf_presetlookup_size(res->presetNum) - 1;
+	if (!(res->fontData = TSF_MALLOC(tsf_fontdata_size(res->presetNum, regionTotal, res->presetLookupMask + 1, 0)))) { TSF_FREE(order); return 0; }
+	tsf_fontdata_place(res, regionTotal);
+	regions = res->regions;
+
+	// Read each preset.
+	for (sortedIndex = 0; sortedIndex != res->presetNum; sortedIndex++)
+	{
+		int region_index = 0;
+		struct tsf_hydra_pbag *ppbag, *ppbagEnd;
+		struct tsf_region globalRegion;
+		pphdr = &hydra->phdrs[order[sortedIndex]];
+		preset = &res->presets[sortedIndex];
+		TSF_MEMCPY(preset->presetName, pphdr->presetName, sizeof(preset->presetName));
+		preset->presetName[sizeof(preset->presetName)-1] = '\0'; //should be zero terminated in source file but make sure
+		preset->bank = pphdr->bank;
+		preset->preset = pphdr->preset;
+		preset->regions = regions;
+		preset->regionNum = regionNums[sortedIndex];
+		preset->keyBands = TSF_NULL;
+		regions += preset->regionNum;
+		tsf_region_clear(&globalRegion, TSF_TRUE);
+
+		// Zones.
+		for (ppbag = hydra->pbags + pphdr->presetBagNdx, ppbagEnd = hydra->pbags + pphdr[1].presetBagNdx; ppbag != ppbagEnd; ppbag++)
+		{
+			struct tsf_hydra_pgen *ppgen, *ppgenEnd; struct tsf_hydra_inst *pinst; struct tsf_hydra_ibag *pibag, *pibagEnd; struct tsf_hydra_igen *pigen, *pigenEnd;
+			struct tsf_region presetRegion = globalRegion;
+			int hadGenInstrument = 0;
+
+			// Generators.
+			for (ppgen = hydra->pgens + ppbag->genNdx, ppgenEnd = hydra->pgens + ppbag[1].genNdx; ppgen != ppgenEnd; ppgen++)
+			{
+				// Instrument.
+				if (ppgen->genOper == GenInstrument)
+				{
+					struct tsf_region instRegion;
+					tsf_u16 whichInst = ppgen->genAmount.wordAmount;
+					if (whichInst >= hydra->instNum) continue;
+
+					tsf_region_clear(&instRegion, TSF_FALSE);
+					pinst = &hydra->insts[whichInst];
+					for (pibag = hydra->ibags + pinst->instBagNdx, pibagEnd = hydra->ibags + pinst[1].instBagNdx; pibag != pibagEnd; pibag++)
+					{
+						// Generators.
+						struct tsf_region zoneRegion = instRegion;
+						int hadSampleID = 0;
+						for (pigen = hydra->igens + pibag->instGenNdx, pigenEnd = hydra->igens + pibag[1].instGenNdx; pigen != pigenEnd; pigen++)
+						{
+							if (pigen->genOper == GenSampleID)
+							{
+								struct tsf_hydra_shdr* pshdr;
+
+								//preset region key and vel ranges are a filter for the zone regions
+								if (zoneRegion.hikey < presetRegion.lokey || zoneRegion.lokey > presetRegion.hikey) continue;
+								if (zoneRegion.hivel < presetRegion.lovel || zoneRegion.lovel > presetRegion.hivel) continue;
+								if (presetRegion.lokey > zoneRegion.lokey) zoneRegion.lokey = presetRegion.lokey;
+								if (presetRegion.hikey < zoneRegion.hikey) zoneRegion.hikey = presetRegion.hikey;
+								if (presetRegion.lovel > zoneRegion.lovel) zoneRegion.lovel = presetRegion.lovel;
+								if (presetRegion.hivel < zoneRegion.hivel) zoneRegion.hivel = presetRegion.hivel;
+
+								//sum regions
+								tsf_region_operator(&zoneRegion, 0, TSF_NULL, &presetRegion);
+
+								// EG times need to be converted from timecents to seconds.
+								tsf_region_envtosecs(&zoneRegion.ampenv, TSF_TRUE);
+								tsf_region_envtosecs(&zoneRegion.modenv, TSF_FALSE);
+
+								// LFO times need to be converted from timecents to seconds.
+								zoneRegion.delayModLFO = (zoneRegion.delayModLFO < -11950.0f ? 0.0f : tsf_timecents2Secsf(zoneRegion.delayModLFO));
+								zoneRegion.delayVibLFO = (zoneRegion.delayVibLFO < -11950.0f ? 0.0f : tsf_timecents2Secsf(zoneRegion.delayVibLFO));
+
+								// Fixup sample positions
+								pshdr = &hydra->shdrs[pigen->genAmount.wordAmount];
+								zoneRegion.offset += pshdr->start;
+								zoneRegion.end += pshdr->end;
+								zoneRegion.loop_start += pshdr->startLoop;
+								zoneRegion.loop_end += pshdr->endLoop;
+								if (pshdr->endLoop > 0) zoneRegion.loop_end -= 1;
+								if (zoneRegion.loop_end > fontSampleCount) zoneRegion.loop_end = fontSampleCount;
+								if (zoneRegion.pitch_keycenter == -1) zoneRegion.pitch_keycenter = pshdr->originalPitch;
+								zoneRegion.tune += pshdr->pitchCorrection;
+								zoneRegion.sample_rate = pshdr->sampleRate;
+								if (zoneRegion.end && zoneRegion.end < fontSampleCount) zoneRegion.end++;
+								else zoneRegion.end = fontSampleCount;
+
+								zoneRegion.sampleIndex = pigen->genAmount.wordAmount;
+								preset->regions[region_index] = zoneRegion;
+								region_index++;
+								hadSampleID = 1;
+							}
+							else tsf_region_operator(&zoneRegion, pigen->genOper, &pigen->genAmount, TSF_NULL);
+						}
+
+						// Handle instrument's global zone.
+						if (pibag == hydra->ibags + pinst->instBagNdx && !hadSampleID)
+							instRegion = zoneRegion;
+
+						// Modulators (TODO)
+						//if (ibag->instModNdx < ibag[1].instModNdx) addUnsupportedOpcode("any modulator");
+					}
+					hadGenInstrument = 1;
+				}
+				else tsf_region_operator(&presetRegion, ppgen->genOper, &ppgen->genAmount, TSF_NULL);
+			}
+
+			// Modulators (TODO)
+			//if (pbag->modNdx < pbag[1].modNdx) addUnsupportedOpcode("any modulator");
+
+			// Handle preset's global zone.
+			if (ppbag == hydra->pbags + pphdr->presetBagNdx && !hadGenInstrument)
+				globalRegion = presetRegion;
+		}
+	}
+	TSF_FREE(order);
+	return 1;
+}
+
+#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
+static int tsf_decode_ogg(const tsf_u8 *pSmpl, const tsf_u8 *pSmplEnd, float** pRes, tsf_u32* pResNum, tsf_u32* pResMax, tsf_u32 resInitial)
+{
+	float *res = *pRes, *oldres; tsf_u32 resNum = *pResNum; tsf_u32 resMax = *pResMax; stb_vorbis *v;
+
+	// Use whatever stb_vorbis API that is available (either pull or push)
+	#if !defined(STB_VORBIS_NO_PULLDATA_API) && !defined(STB_VORBIS_NO_FROMMEMORY)
+	v = stb_vorbis_open_memory(pSmpl, (int)(pSmplEnd - pSmpl), TSF_NULL, TSF_NULL);
+	#else
+	{ int use, err; v = stb_vorbis_open_pushdata(pSmpl, (int)(pSmplEnd - pSmpl), &use, &err, TSF_NULL); pSmpl += use; }
+	#endif
+	if (v == TSF_NULL) return 0;
+
+	for (;;)
+	{
+		float** outputs; int n_samples;
+
+		// Decode one frame of vorbis samples with whatever stb_vorbis API that is available
+		#if !defined(STB_VORBIS_NO_PULLDATA_API) && !defined(STB_VORBIS_NO_FROMMEMORY)
+		n_samples = stb_vorbis_get_frame_float(v, TSF_NULL, &outputs);
+		if (!n_samples) break;
+		#else
+		if (pSmpl >= pSmplEnd) break;
+		{ int use = stb_vorbis_decode_frame_pushdata(v, pSmpl, (int)(pSmplEnd - pSmpl), TSF_NULL, &outputs, &n_samples); pSmpl += use; }
+		if (!n_samples) continue;
+		#endif
+
+		// Expand our output buffer if necessary then copy over the decoded frame samples
+		resNum += n_samples;
+		if (resNum > resMax)
+		{
+			do { resMax += (resMax ? (resMax < 1048576 ? resMax : 1048576) : resInitial); } while (resNum > resMax);
+			res = (float*)TSF_REALLOC((oldres = res), resMax * sizeof(float));
+			if (!res) { TSF_FREE(oldres); stb_vorbis_close(v); return 0; }
+		}
+		TSF_MEMCPY(res + resNum - n_samples, outputs[0], n_samples * sizeof(float));
+	}
+	stb_vorbis_close(v);
+	*pRes = res; *pResNum = resNum; *pResMax = resMax;
+	return 1;
+}
+
+static int tsf_decode_sf3_samples(const void* rawBuffer, float** pFloatBuffer, unsigned int* pSmplCount, struct tsf_hydra *hydra)
+{
+	const tsf_u8* smplBuffer = (const tsf_u8*)rawBuffer;
+	tsf_u32 smplLength = *pSmplCount, resNum = 0, resMax = 0, resInitial = (smplLength > 0x100000 ? (smplLength & ~0xFFFFF) : 65536);
+	float *res = TSF_NULL, *oldres;
+	int i, shdrLast = hydra->shdrNum - 1, is_sf3 = 0;
+	for (i = 0; i <= shdrLast; i++)
+	{
+		struct tsf_hydra_shdr *shdr = &hydra->shdrs[i];
+		if (shdr->sampleType & 0x30) // compression flags (sometimes Vorbis flag)
+		{
+			const tsf_u8 *pSmpl = smplBuffer + shdr->start, *pSmplEnd = smplBuffer + shdr->end;
+			if (pSmpl + 4 > pSmplEnd || !TSF_FourCCEquals(pSmpl, "OggS"))
+			{
+				shdr->start = shdr->end = shdr->startLoop = shdr->endLoop = 0;
+				continue;
+			}
+
+			// Fix up sample indices in shdr (end index is set after decoding)
+			shdr->start = resNum;
+			shdr->startLoop += resNum;
+			shdr->endLoop += resNum;
+			if (!tsf_decode_ogg(pSmpl, pSmplEnd, &res, &resNum, &resMax, resInitial)) { TSF_FREE(res); return 0; }
+			shdr->end = resNum;
+			is_sf3 = 1;
+		}
+		else // raw PCM sample
+		{
+			float *out; short *in = (short*)smplBuffer + resNum, *inEnd; tsf_u32 oldResNum = resNum;
+			if (is_sf3) // Fix up sample indices in shdr
+			{
+				tsf_u32 fix_offset = resNum - shdr->start;
+				in -= fix_offset;
+				shdr->start = resNum;
+				shdr->end += fix_offset;
+				shdr->startLoop += fix_offset;
+				shdr->endLoop += fix_offset;
+			}
+			inEnd = in + ((shdr->end >= shdr->endLoop ? shdr->end : shdr->endLoop) - resNum);
+			if (i == shdrLast || (tsf_u8*)inEnd > (smplBuffer + smplLength)) inEnd = (short*)(smplBuffer + smplLength);
+			if (inEnd <= in) continue;
+
+			// expand our output buffer if necessary then convert the PCM data from short to float
+			resNum += (tsf_u32)(inEnd - in);
+			if (resNum > resMax)
+			{
+				do { resMax += (resMax ? (resMax < 1048576 ? resMax : 1048576) : resInitial); } while (resNum > resMax);
+				res = (float*)TSF_REALLOC((oldres = res), resMax * sizeof(float));
+				if (!res) { TSF_FREE(oldres); return 0; }
+			}
+
+			// Convert the samples from short to float
+			for (out = res + oldResNum; in < inEnd;)
+				*(out++) = (float)(*(in++) / 32767.0);
+		}
+	}
+
+	// Trim the sample buffer down then return success (unless out of memory)
+	if (!(*pFloatBuffer = (float*)TSF_REALLOC(res, resNum * sizeof(float)))) *pFloatBuffer = res;
+	*pSmplCount = resNum;
+	return (res ? 1 : 0);
+}
+#endif
+
+// Converts count 16-bit samples read into the start of buffer in place
+static void tsf_convert_samples(tsf_sample* buffer, tsf_u32 count)
+{
+	#ifdef TSF_SAMPLES_SHORT
+	(void)buffer, (void)count;
+	#else
+	// Back to front because the floats take twice the space of the shorts they are made from
+	float *out = buffer + count; const short *in = (short*)buffer + count;
+	#if defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE)
+	for (; count & 7; count--)
+		*(--out) = (float)(*(--in) / 32767.0);
+	for (; out != buffer; out -= 8, in -= 8)
+	{
+		// All 8 shorts are loaded before the floats overwrite any of them
+		#if defined(TSF_SIMD_NEON)
+		int16x8_t s = vld1q_s16(in - 8);
+		float32x4_t scale = vdupq_n_f32(1.0f / 32767.0f);
+		vst1q_f32(out - 8, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+		vst1q_f32(out - 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+		#else
+		__m128i s = _mm_loadu_si128((const __m128i*)(in - 8));
+		__m128 scale = _mm_set1_ps(32767.0f);
+		_mm_storeu_ps(out - 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)), scale));
+		_mm_storeu_ps(out - 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)), scale));
+		#endif
+	}
+	#else
+	while (out != buffer)
+		*(--out) = (float)(*(--in) / 32767.0);
+	#endif
+	#endif
+}
+
+static int tsf_load_samples(void** pRawBuffer, tsf_sample** pSampleBuffer, unsigned int* pSmplCount, struct tsf_riffchunk *chunkSmpl, struct tsf_stream* stream)
+{
+	#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
+	// With OGG Vorbis support we cannot pre-allocate the memory for tsf_decode_sf3_samples
+	tsf_u32 resNum, resMax; float* oldres;
+	*pSmplCount = chunkSmpl->size;
+	*pRawBuffer = (void*)TSF_MALLOC(*pSmplCount);
+	if (!*pRawBuffer || !stream->read(stream->data, *pRawBuffer, chunkSmpl->size)) return 0;
+	if (chunkSmpl->id[3] != 'o') return 1;
+
+	// Decode custom .sfo 'smpo' format where all samples are in a single ogg stream
+	resNum = resMax = 0;
+	if (!tsf_decode_ogg((tsf_u8*)*pRawBuffer, (tsf_u8*)*pRawBuffer + chunkSmpl->size, pSampleBuffer, &resNum, &resMax, 65536)) return 0;
+	if (!(*pSampleBuffer = (float*)TSF_REALLOC((oldres = *pSampleBuffer), resNum * sizeof(float)))) *pSampleBuffer = oldres;
+	*pSmplCount = resNum;
+	return (*pSampleBuffer ? 1 : 0);
+	#elif defined(TSF_SAMPLES_SHORT)
+	// Samples stay as they are in the file
+	*pSmplCount = chunkSmpl->size / (unsigned int)sizeof(short);
+	*pSampleBuffer = (tsf_sample*)TSF_MALLOC(chunkSmpl->size);
+	return (*pSampleBuffer && stream->read(stream->data, *pSampleBuffer, chunkSmpl->size));
+	#else
+	// Inline convert the samples from short to float
+	*pSmplCount = chunkSmpl->size / (unsigned int)sizeof(short);
+	*pSampleBuffer = (float*)TSF_MALLOC(*pSmplCount * sizeof(float));
+	if (!*pSampleBuffer || !stream->read(stream->data, *pSampleBuffer, chunkSmpl->size)) return 0;
+	tsf_convert_samples(*pSampleBuffer, *pSmplCount);
+	return 1;
+	#endif
+}
+
+static int tsf_voice_envelope_release_samples(struct tsf_voice_envelope* e, float outSampleRate)
+{
+	return (int)((e->parameters.release <= 0 ? TSF_FASTRELEASETIME : e->parameters.release) * outSampleRate);
+}
+
+static void tsf_voice_envelope_nextsegment(struct tsf_voice_envelope* e, short active_segment, float outSampleRate)
+{
+	switch (active_segment)
+	{
+		case TSF_SEGMENT_NONE:
+			e->samplesUntilNextSegment = (int)(e->parameters.delay * outSampleRate);
+			if (e->samplesUntilNextSegment > 0)
+			{
+				e->segment = TSF_SEGMENT_DELAY;
+				e->segmentIsExponential = TSF_FALSE;
+				e->level = 0.0;
+				e->slope = 0.0;
+				return;
+			}
+			/* fall through */
+		case TSF_SEGMENT_DELAY:
+			e->samplesUntilNextSegment = (int)(e->parameters.attack * outSampleRate);
+			if (e->samplesUntilNextSegment > 0)
+			{
+				if (!e->isAmpEnv)
+				{
+					//mod env attack duration scales with velocity (velocity of 1 is full duration, max velocity is 0.125 times duration)
+					e->samplesUntilNextSegment = (int)(e->parameters.attack * ((145 - e->midiVelocity) / 144.0f) * outSampleRate);
+				}
+				e->segment = TSF_SEGMENT_ATTACK;
+				e->segmentIsExponential = TSF_FALSE;
+				e->level = 0.0f;
+				e->slope = 1.0f / e->samplesUntilNextSegment;
+				return;
+			}
+			/* fall through */
+		case TSF_SEGMENT_ATTACK:
+			e->samplesUntilNextSegment = (int)(e->parameters.hold * outSampleRate);
+			if (e->samplesUntilNextSegment > 0)
+			{
+				e->segment = TSF_SEGMENT_HOLD;
+				e->segmentIsExponential = TSF_FALSE;
+				e->level = 1.0f;
+				e->slope = 0.0f;
+				return;
+			}
+			/* fall through */
+		case TSF_SEGMENT_HOLD:
+			e->samplesUntilNextSegment = (int)(e->parameters.decay * outSampleRate);
+			if (e->samplesUntilNextSegment > 0)
+			{
+				e->segment = TSF_SEGMENT_DECAY;
+				e->level = 1.0f;
+				if (e->isAmpEnv)
+				{
+					// I don't truly understand this; just following what LinuxSampler does.
+					float mysterySlope = -9.226f / e->samplesUntilNextSegment;
+					e->slope = TSF_EXPF(mysterySlope);
+					e->segmentIsExponential = TSF_TRUE;
+					if (e->parameters.sustain > 0.0f)
+					{
+						// Again, this is following LinuxSampler's example, which is similar to
+						// SF2-style decay, where "decay" specifies the time it would take to
+						// get to zero, not to the sustain level.  The SFZ spec is not that
+						// specific about what "decay" means, so perhaps it's really supposed
+						// to specify the time to reach the sustain level.
+						e->samplesUntilNextSegment = (int)(TSF_LOG(e->parameters.sustain) / mysterySlope);
+					}
+				}
+				else
+				{
+					e->slope = -1.0f / e->samplesUntilNextSegment;
+					e->samplesUntilNextSegment = (int)(e->parameters.decay * (1.0f - e->parameters.sustain) * outSampleRate);
+					e->segmentIsExponential = TSF_FALSE;
+				}
+				return;
+			}
+			/* fall through */
+		case TSF_SEGMENT_DECAY:
+			e->segment = TSF_SEGMENT_SUSTAIN;
+			e->level = e->parameters.sustain;
+			e->slope = 0.0f;
+			e->samplesUntilNextSegment = 0x7FFFFFFF;
+			e->segmentIsExponential = TSF_FALSE;
+			return;
+		case TSF_SEGMENT_SUSTAIN:
+			e->segment = TSF_SEGMENT_RELEASE;
+			e->samplesUntilNextSegment = tsf_voice_envelope_release_samples(e, outSampleRate);
+			if (e->isAmpEnv)
+			{
+				// I don't truly understand this; just following what LinuxSampler does.
+				float mysterySlope = -9.226f / e->samplesUntilNextSegment;
+				e->slope = TSF_EXPF(mysterySlope);
+				e->segmentIsExponential = TSF_TRUE;
+			}
+			else
+			{
+				e->slope = -e->level / e->samplesUntilNextSegment;
+				e->segmentIsExponential = TSF_FALSE;
+			}
+			return;
+		case TSF_SEGMENT_RELEASE:
+		default:
+			e->segment = TSF_SEGMENT_DONE;
+			e->segmentIsExponential = TSF_FALSE;
+			e->level = e->slope = 0.0f;
+			e->samplesUntilNextSegment = 0x7FFFFFF;
+	}
+}
+
+static void tsf_voice_envelope_setup(struct tsf_voice_envelope* e, struct tsf_envelope* new_parameters, int midiNoteNumber, short midiVelocity, TSF_BOOL isAmpEnv, float outSampleRate)
+{
+	e->parameters = *new_parameters;
+	if (e->parameters.keynumToHold)
+	{
+		e->parameters.hold += e->parameters.keynumToHold * (60.0f - midiNoteNumber);
+		e->parameters.hold = (e->parameters.hold < -10000.0f ? 0.0f : tsf_timecents2Secsf(e->parameters.hold));
+	}
+	if (e->parameters.keynumToDecay)
+	{
+		e->parameters.decay += e->parameters.keynumToDecay * (60.0f - midiNoteNumber);
+		e->parameters.decay = (e->parameters.decay < -10000.0f ? 0.0f : tsf_timecents2Secsf(e->parameters.decay));
+	}
+	e->midiVelocity = midiVelocity;
+	e->isAmpEnv = isAmpEnv;
+	tsf_voice_envelope_nextsegment(e, TSF_SEGMENT_NONE, outSampleRate);
+}
+
+static void tsf_voice_envelope_process(struct tsf_voice_envelope* e, int numSamples, float outSampleRate)
+{
+	if (e->slope)
+	{
+		if (e->segmentIsExponential) e->level *= TSF_POWF(e->slope, (float)numSamples);
+		else e->level += (e->slope * numSamples);
+	}
+	if ((e->samplesUntilNextSegment -= numSamples) <= 0)
+		tsf_voice_envelope_nextsegment(e, e->segment, outSampleRate);
+}
+
+static void tsf_voice_lowpass_setup(struct tsf_voice_lowpass* e, float Fc)
+{
+	// Lowpass filter from http://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
+	// Coefficients are worked out in double, the filter itself runs in float (see tsf_voice_lowpass_process4).
+	double K = TSF_TAN(TSF_PI * Fc), KK = K * K;
+	double norm = 1 / (1 + K * e->QInv + KK), a0 = KK * norm;
+	e->a0 = (float)a0;
+	e->a1 = (float)(2 * a0);
+	e->b1 = (float)(2 * (KK - 1) * norm);
+	e->b2 = (float)((1 - K * e->QInv + KK) * norm);
+}
+
+// Filter state this small is inaudible and would otherwise decay into denormals, which are very slow on some FPUs
+#define TSF_DENORMAL_LIMIT 1e-15f
+
+#if defined(TSF_SIMD_NEON)
+#define TSF_TRANSPOSE4(x0, x1, x2, x3) { \
+	float32x4x2_t t01 = vtrnq_f32(x0, x1), t23 = vtrnq_f32(x2, x3); \
+	x0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])); \
+	x1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])); \
+	x2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])); \
+	x3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])); }
+#define TSF_LOWPASS4_STEP(x) { \
+	float32x4_t out = vaddq_f32(vmulq_f32(x, a0), z1); \
+	z1 = vsubq_f32(vaddq_f32(vmulq_f32(x, a1), z2), vmulq_f32(b1, out)); \
+	z2 = vsubq_f32(vmulq_f32(x, a0), vmulq_f32(b2, out)); \
+	x = out; }
+#elif defined(TSF_SIMD_SSE)
+#define TSF_TRANSPOSE4(x0, x1, x2, x3) _MM_TRANSPOSE4_PS(x0, x1, x2, x3)
+#define TSF_LOWPASS4_STEP(x) { \
+	__m128 out = _mm_add_ps(_mm_mul_ps(x, a0), z1); \
+	z1 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(x, a1), z2), _mm_mul_ps(b1, out)); \
+	z2 = _mm_sub_ps(_mm_mul_ps(x, a0), _mm_mul_ps(b2, out)); \
+	x = out; }
+#endif
+
+// Runs the low-pass filters of 4 voices in lock-step over their block buffers.
+// Lanes without a filter (NULL) get pass-through coefficients and are left as they are.
+static void tsf_voice_lowpass_process4(struct tsf_voice_lowpass* lowpass[4], float* bufs[4], int numSamples)
+{
+	float la0[4], la1[4], lb1[4], lb2[4], lz1[4], lz2[4];
+	int lane, i = 0;
+	for (lane = 0; lane != 4; lane++)
+	{
+		struct tsf_voice_lowpass* e = lowpass[lane];
+		if (e) la0[lane] = e->a0, la1[lane] = e->a1, lb1[lane] = e->b1, lb2[lane] = e->b2, lz1[lane] = e->z1, lz2[lane] = e->z2;
+		else la0[lane] = 1.0f, la1[lane] = lb1[lane] = lb2[lane] = lz1[lane] = lz2[lane] = 0.0f;
+	}
+
+#if defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE)
+	{
+		// 4 frames at a time: transpose so each vector holds one frame of all 4 voices,
+		// step the filters once per frame, then transpose back.
+#if defined(TSF_SIMD_NEON)
+		float32x4_t a0 = vld1q_f32(la0), a1 = vld1q_f32(la1), b1 = vld1q_f32(lb1), b2 = vld1q_f32(lb2), z1 = vld1q_f32(lz1), z2 = vld1q_f32(lz2);
+		for (; i + 4 <= numSamples; i += 4)
+		{
+			float32x4_t x0 = vld1q_f32(bufs[0] + i), x1 = vld1q_f32(bufs[1] + i), x2 = vld1q_f32(bufs[2] + i), x3 = vld1q_f32(bufs[3] + i);
+			TSF_TRANSPOSE4(x0, x1, x2, x3);
+			TSF_LOWPASS4_STEP(x0) TSF_LOWPASS4_STEP(x1) TSF_LOWPASS4_STEP(x2) TSF_LOWPASS4_STEP(x3)
+			TSF_TRANSPOSE4(x0, x1, x2, x3);
+			vst1q_f32(bufs[0] + i, x0), vst1q_f32(bufs[1] + i, x1), vst1q_f32(bufs[2] + i, x2), vst1q_f32(bufs[3] + i, x3);
+		}
+		vst1q_f32(lz1, z1), vst1q_f32(lz2, z2);
+#else
+		__m128 a0 = _mm_loadu_ps(la0), a1 = _mm_loadu_ps(la1), b1 = _mm_loadu_ps(lb1), b2 = _mm_loadu_ps(lb2), z1 = _mm_loadu_ps(lz1), z2 = _mm_loadu_ps(lz2);
+		for (; i + 4 <= numSamples; i += 4)
+		{
+			__m128 x0 = _mm_loadu_ps(bufs[0] + i), x1 = _mm_loadu_ps(bufs[1] + i), x2 = _mm_loadu_ps(bufs[2] + i), x3 = _mm_loadu_ps(bufs[3] + i);
+			TSF_TRANSPOSE4(x0, x1, x2, x3);
+			TSF_LOWPASS4_STEP(x0) TSF_LOWPASS4_STEP(x1) TSF_LOWPASS4_STEP(x2) TSF_LOWPASS4_STEP(x3)
+			TSF_TRANSPOSE4(x0, x1, x2, x3);
+			_mm_storeu_ps(bufs[0] + i, x0), _mm_storeu_ps(bufs[1] + i, x1), _mm_storeu_ps(bufs[2] + i, x2), _mm_storeu_ps(bufs[3] + i, x3);
+		}
+		_mm_storeu_ps(lz1, z1), _mm_storeu_ps(lz2, z2);
+#endif
+	}
+#endif
+
+	for (; i != numSamples; i++)
+		for (lane = 0; lane != 4; lane++)
+		{
+			float In = bufs[lane][i], Out = In * la0[lane] + lz1[lane];
+			lz1[lane] = In * la1[lane] + lz2[lane] - lb1[lane] * Out;
+			lz2[lane] = In * la0[lane] - lb2[lane] * Out;
+			bufs[lane][i] = Out;
+		}
+
+	for (lane = 0; lane != 4; lane++)
+	{
+		struct tsf_voice_lowpass* e = lowpass[lane];
+		if (!e) continue;
+		e->z1 = (lz1[lane] > -TSF_DENORMAL_LIMIT && lz1[lane] < TSF_DENORMAL_LIMIT ? 0.0f : lz1[lane]);
+		e->z2 = (lz2[lane] > -TSF_DENORMAL_LIMIT && lz2[lane] < TSF_DENORMAL_LIMIT ? 0.0f : lz2[lane]);
+	}
+}
+
+static void tsf_voice_lfo_setup(struct tsf_voice_lfo* e, float delay, int freqCents, float outSampleRate)
+{
+	e->samplesUntil = (int)(delay * outSampleRate);
+	e->delta = (4.0f * tsf_cents2Hertz((float)freqCents) / outSampleRate);
+	e->level = 0;
+}
+
+static void tsf_voice_lfo_process(struct tsf_voice_lfo* e, int blockSamples)
+{
+	if (e->samplesUntil > blockSamples) { e->samplesUntil -= blockSamples; return; }
+	e->level += e->delta * blockSamples;
+	if      (e->level >  1.0f) { e->delta = -e->delta; e->level =  2.0f - e->level; }
+	else if (e->level < -1.0f) { e->delta = -e->delta; e->level = -2.0f - e->level; }
+}
+
+static struct tsf_voice_hot* tsf_voice_gethot(tsf* f, struct tsf_voice* v)
+{
+	return &f->voiceHot[v - f->voices];
+}
+
+// Takes the next free voice, or returns NULL if all are playing
+static struct tsf_voice* tsf_voice_alloc(tsf* f)
+{
+	struct tsf_voice* v;
+	if (f->activeVoiceNum == f->voiceNum) return TSF_NULL;
+	v = &f->voices[f->voiceSlots[f->activeVoiceNum]];
+	v->activeIndex = f->activeVoiceNum++;
+	if (f->activeVoiceNum > f->stats.peakVoices) f->stats.peakVoices = f->activeVoiceNum;
+	return v;
+}
+
+static struct tsf_voice_list* tsf_voice_list_get(tsf* f, struct tsf_voice* v, int list)
+{
+	switch (list)
+	{
+		case TSF_VOICELIST_RELEASE: return &f->releaseVoices;
+		case TSF_VOICELIST_KEY:     return &f->keyVoices[v->playingKey];
+		case TSF_VOICELIST_CHANNEL: return &f->channels->channels[v->playingChannel].voices;
+		default:                    return &f->groupVoices;
+	}
+}
+
+static void tsf_voice_unlink(tsf* f, struct tsf_voice* v, int list)
+{
+	struct tsf_voice_list* l;
+	struct tsf_voice_link* k = &v->links[list];
+	if (!(v->linked & (1 << list))) return;
+	l = tsf_voice_list_get(f, v, list);
+	if (k->prev != -1) f->voices[k->prev].links[list].next = k->next;
+	else l->first = k->next;
+	if (k->next != -1) f->voices[k->next].links[list].prev = k->prev;
+	else l->last = k->prev;
+	l->count--;
+	v->linked &= ~(1 << list);
+}
+
+// Appends a voice to one of its lists, if it was in it already it moves to the end
+static void tsf_voice_link(tsf* f, struct tsf_voice* v, int list)
+{
+	int index = (int)(v - f->voices);
+	struct tsf_voice_list* l = tsf_voice_list_get(f, v, list);
+	tsf_voice_unlink(f, v, list);
+	v->links[list].prev = l->last;
+	v->links[list].next = -1;
+	if (l->last != -1) f->voices[l->last].links[list].next = index;
+	else l->first = index;
+	l->last = index;
+	l->count++;
+	v->linked |= (1 << list);
+}
+
+static void tsf_voice_lists_init(struct tsf_voice_list* l, int count)
+{
+	for (; count--; l++) { l->first = l->last = -1; l->count = 0; }
+}
+
+static void tsf_voice_kill(tsf* f, struct tsf_voice* v)
+{
+	struct tsf_voice_hot* h;
+	int last, list, index = (int)(v - f->voices);
+	if (v->playingPreset == -1) return;
+	for (list = 0; list != TSF_VOICELIST_COUNT; list++)
+		tsf_voice_unlink(f, v, list);
+	h = tsf_voice_gethot(f, v);
+	if (h->stream != -1)
+	{
+		// The I/O thread frees the ring once it's sure not to be writing into it
+		f->streamRings[h->stream].state = TSF_STREAM_RETIRED;
+		h->stream = -1;
+	}
+	// Move the last active voice into the freed place, which puts this one first in the free part
+	last = f->voiceSlots[--f->activeVoiceNum];
+	f->voiceSlots[v->activeIndex] = last;
+	f->voices[last].activeIndex = v->activeIndex;
+	f->voiceSlots[f->activeVoiceNum] = index;
+	v->playingPreset = -1;
+}
+
+static void tsf_voice_end(tsf* f, struct tsf_voice* v)
+{
+	struct tsf_voice_hot* h = tsf_voice_gethot(f, v);
+	// if maxVoiceNum is set, assume that voice rendering and note queuing are on separate threads
+	// so to minimize the chance that voice rendering would advance the segment at the same time
+	// we just do it twice here and hope that it sticks
+	int repeats = (f->maxVoiceNum ? 2 : 1);
+	while (repeats--)
+	{
+		tsf_voice_envelope_nextsegment(&h->ampenv, TSF_SEGMENT_SUSTAIN, f->outSampleRate);
+		tsf_voice_envelope_nextsegment(&h->modenv, TSF_SEGMENT_SUSTAIN, f->outSampleRate);
+		if (v->region->loop_mode == TSF_LOOPMODE_SUSTAIN)
+		{
+			// Continue playing, but stop looping.
+			h->loopEnd = h->loopStart;
+		}
+	}
+	// Queue for stealing, the first in the queue is the furthest into its release
+	if (h->ampenv.segment == TSF_SEGMENT_RELEASE) tsf_voice_link(f, v, TSF_VOICELIST_RELEASE);
+}
+
+static void tsf_voice_endquick(tsf* f, struct tsf_voice* v)
+{
+	struct tsf_voice_hot* h = tsf_voice_gethot(f, v);
+	// if maxVoiceNum is set, assume that voice rendering and note queuing are on separate threads
+	// so to minimize the chance that voice rendering would advance the segment at the same time
+	// we just do it twice here and hope that it sticks
+	int repeats = (f->maxVoiceNum ? 2 : 1);
+	while (repeats--)
+	{
+		h->ampenv.parameters.release = 0.0f; tsf_voice_envelope_nextsegment(&h->ampenv, TSF_SEGMENT_SUSTAIN, f->outSampleRate);
+		h->modenv.parameters.release = 0.0f; tsf_voice_envelope_nextsegment(&h->modenv, TSF_SEGMENT_SUSTAIN, f->outSampleRate);
+	}
+	// Queue for stealing, the first in the queue is the furthest into its release
+	if (h->ampenv.segment == TSF_SEGMENT_RELEASE) tsf_voice_link(f, v, TSF_VOICELIST_RELEASE);
+}
+
+static void tsf_voice_calcpitchratio(struct tsf_voice* v, struct tsf_voice_hot* h, float pitchShift, float outSampleRate)
+{
+	double note = v->playingKey + v->region->transpose + v->region->tune / 100.0;
+	double adjustedPitch = v->region->pitch_keycenter + (note - v->region->pitch_keycenter) * (v->region->pitch_keytrack / 100.0);
+	if (pitchShift) adjustedPitch += pitchShift;
+	h->pitchInputTimecents = adjustedPitch * 100.0;
+	h->pitchOutputFactor = v->region->sample_rate / (tsf_timecents2Secsd(v->region->pitch_keycenter * 100.0) * outSampleRate);
+	// Used as is unless modulators move the pitch, then it's worked out per block
+	h->pitchRatio = tsf_timecents2Secsd(h->pitchInputTimecents) * h->pitchOutputFactor;
+}
+
+// Linearly interpolates up to numSamples source samples into buf and advances the position.
+// Stops early at the end of the sample, returns the number of samples produced.
+// Positions advance in 32.32 fixed point: an integer frame index plus a 32 bit fraction, stepping by
+// the pitch ratio converted once per call. That keeps doubles out of the per-frame work, the index is
+// ready for addressing and the top 24 bits of the fraction make the interpolation alpha.
+#define TSF_PHASE_ADVANCE(pos, frac, stepInt, stepFrac) (frac += stepFrac, pos += stepInt + (frac < stepFrac))
+#define TSF_PHASE_ALPHA_SCALE (1.0f / 16777216.0f)
+
+#if defined(TSF_SAMPLES_SHORT) && (defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE))
+// Reads 16-bit frames i and i + 1 as one little-endian 32-bit value, frame i in the low half
+static int tsf_sample_pair(const tsf_sample* input, unsigned int i)
+{
+	int pair;
+	TSF_MEMCPY(&pair, input + i, sizeof(pair));
+	return pair;
+}
+#endif
+
+static int tsf_voice_interpolate(const tsf_sample* input, float* buf, int numSamples, unsigned int* phaseInt, unsigned int* phaseFrac, double pitchRatio, unsigned int sampleEnd, unsigned int loopStart, unsigned int loopEnd, TSF_BOOL isLooping)
+{
+	unsigned int pos = *phaseInt, frac = *phaseFrac, loopLength = loopEnd - loopStart + 1;
+	unsigned int stepInt = (unsigned int)pitchRatio, stepFrac = (unsigned int)((pitchRatio - stepInt) * 4294967296.0);
+	// The last frame of a fast run and the one after it must still be inside the loop or the sample
+	unsigned int lookahead = (unsigned int)(pitchRatio * 3.0) + 1, limit = (isLooping ? loopEnd : (sampleEnd ? sampleEnd - 1 : 0));
+	unsigned int fastEnd = (limit > lookahead ? limit - lookahead : 0);
+	int n = 0, groupEnd;
+	for (;;)
+	{
+		// Runs of 4 frames clear of the loop end and the sample end need no per-frame checks.
+		// The sample reads are gathers so the positions are stepped in scalar registers,
+		// with SIMD the lanes are filled straight from registers and all 4 are interpolated at once.
+		for (; n + 4 <= numSamples && pos < fastEnd; n += 4)
+		{
+			unsigned int i0 = pos, f0 = frac, i1 = i0, f1 = f0, i2, f2, i3, f3;
+			TSF_PHASE_ADVANCE(i1, f1, stepInt, stepFrac); i2 = i1, f2 = f1;
+			TSF_PHASE_ADVANCE(i2, f2, stepInt, stepFrac); i3 = i2, f3 = f2;
+			TSF_PHASE_ADVANCE(i3, f3, stepInt, stepFrac);
+#if defined(TSF_SIMD_NEON) && defined(TSF_SAMPLES_SHORT)
+			{
+				// Each frame and the one after it are next to each other, one 32-bit load fetches both
+				int32x4_t vpair = vdupq_n_s32(tsf_sample_pair(input, i0)); float32x4_t va, vb, valpha;
+				uint32x4_t vfrac = vdupq_n_u32(f0);
+				vpair = vsetq_lane_s32(tsf_sample_pair(input, i1), vpair, 1), vfrac = vsetq_lane_u32(f1, vfrac, 1);
+				vpair = vsetq_lane_s32(tsf_sample_pair(input, i2), vpair, 2), vfrac = vsetq_lane_u32(f2, vfrac, 2);
+				vpair = vsetq_lane_s32(tsf_sample_pair(input, i3), vpair, 3), vfrac = vsetq_lane_u32(f3, vfrac, 3);
+				va = vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(vpair, 16), 16));
+				vb = vcvtq_f32_s32(vshrq_n_s32(vpair, 16));
+				valpha = vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(vfrac, 8)), TSF_PHASE_ALPHA_SCALE);
+				vst1q_f32(buf + n, vaddq_f32(vmulq_f32(va, vsubq_f32(vdupq_n_f32(1.0f), valpha)), vmulq_f32(vb, valpha)));
+			}
+#elif defined(TSF_SIMD_NEON)
+			{
+				float32x4_t va = vdupq_n_f32(input[i0]), vb = vdupq_n_f32(input[i0 + 1]), valpha;
+				uint32x4_t vfrac = vdupq_n_u32(f0);
+				va = vsetq_lane_f32(input[i1], va, 1), vb = vsetq_lane_f32(input[i1 + 1], vb, 1), vfrac = vsetq_lane_u32(f1, vfrac, 1);
+				va = vsetq_lane_f32(input[i2], va, 2), vb = vsetq_lane_f32(input[i2 + 1], vb, 2), vfrac = vsetq_lane_u32(f2, vfrac, 2);
+				va = vsetq_lane_f32(input[i3], va, 3), vb = vsetq_lane_f32(input[i3 + 1], vb, 3), vfrac = vsetq_lane_u32(f3, vfrac, 3);
+				valpha = vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(vfrac, 8)), TSF_PHASE_ALPHA_SCALE);
+				vst1q_f32(buf + n, vaddq_f32(vmulq_f32(va, vsubq_f32(vdupq_n_f32(1.0f), valpha)), vmulq_f32(vb, valpha)));
+			}
+#elif defined(TSF_SIMD_SSE)
+			{
+				#ifdef TSF_SAMPLES_SHORT
+				// Each frame and the one after it are next to each other, one 32-bit load fetches both
+				__m128i vpair = _mm_set_epi32(tsf_sample_pair(input, i3), tsf_sample_pair(input, i2), tsf_sample_pair(input, i1), tsf_sample_pair(input, i0));
+				__m128 va = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(vpair, 16), 16));
+				__m128 vb = _mm_cvtepi32_ps(_mm_srai_epi32(vpair, 16));
+				#else
+				__m128 va = _mm_set_ps(input[i3], input[i2], input[i1], input[i0]);
+				__m128 vb = _mm_set_ps(input[i3 + 1], input[i2 + 1], input[i1 + 1], input[i0 + 1]);
+				#endif
+				__m128i vfrac = _mm_srli_epi32(_mm_set_epi32((int)f3, (int)f2, (int)f1, (int)f0), 8);
+				__m128 valpha = _mm_mul_ps(_mm_cvtepi32_ps(vfrac), _mm_set1_ps(TSF_PHASE_ALPHA_SCALE));
+				_mm_storeu_ps(buf + n, _mm_add_ps(_mm_mul_ps(va, _mm_sub_ps(_mm_set1_ps(1.0f), valpha)), _mm_mul_ps(vb, valpha)));
+			}
+#else
+			{
+				float alpha0 = (int)(f0 >> 8) * TSF_PHASE_ALPHA_SCALE, alpha1 = (int)(f1 >> 8) * TSF_PHASE_ALPHA_SCALE;
+				float alpha2 = (int)(f2 >> 8) * TSF_PHASE_ALPHA_SCALE, alpha3 = (int)(f3 >> 8) * TSF_PHASE_ALPHA_SCALE;
+				#ifdef TSF_SAMPLES_SHORT
+				// Interpolate from the first frame and the integer step to the next, converting each once
+				buf[n    ] = input[i0] + (input[i0 + 1] - input[i0]) * alpha0;
+				buf[n + 1] = input[i1] + (input[i1 + 1] - input[i1]) * alpha1;
+				buf[n + 2] = input[i2] + (input[i2 + 1] - input[i2]) * alpha2;
+				buf[n + 3] = input[i3] + (input[i3 + 1] - input[i3]) * alpha3;
+				#else
+				buf[n    ] = input[i0] * (1.0f - alpha0) + input[i0 + 1] * alpha0;
+				buf[n + 1] = input[i1] * (1.0f - alpha1) + input[i1 + 1] * alpha1;
+				buf[n + 2] = input[i2] * (1.0f - alpha2) + input[i2 + 1] * alpha2;
+				buf[n + 3] = input[i3] * (1.0f - alpha3) + input[i3 + 1] * alpha3;
+				#endif
+			}
+#endif
+			pos = i3, frac = f3;
+			TSF_PHASE_ADVANCE(pos, frac, stepInt, stepFrac);
+			if (pos > loopEnd && isLooping) pos -= loopLength;
+		}
+
+		// Frames near the loop or sample end (and the remainder of the block) go one by one
+		groupEnd = (n + 4 <= numSamples ? n + 4 : numSamples);
+		for (; n != groupEnd && pos < sampleEnd; n++)
+		{
+			unsigned int nextPos = (pos >= loopEnd && isLooping ? loopStart : pos + 1);
+
+			// Simple linear interpolation.
+			float alpha = (int)(frac >> 8) * TSF_PHASE_ALPHA_SCALE;
+			buf[n] = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
+
+			// Next sample.
+			TSF_PHASE_ADVANCE(pos, frac, stepInt, stepFrac);
+			if (pos > loopEnd && isLooping) pos -= loopLength;
+		}
+		if (n != groupEnd || n == numSamples) break;
+	}
+	*phaseInt = pos, *phaseFrac = frac;
+	return n;
+}
+
+// Adds buf * gain to a single output channel
+static void tsf_voice_mix_mono(float* out, const float* buf, int numSamples, float gain)
+{
+	int n = 0;
+#if defined(TSF_SIMD_NEON)
+	float32x4_t vgain = vdupq_n_f32(gain);
+	for (; n + 4 <= numSamples; n += 4)
+		vst1q_f32(out + n, vaddq_f32(vld1q_f32(out + n), vmulq_f32(vld1q_f32(buf + n), vgain)));
+#elif defined(TSF_SIMD_SSE)
+	__m128 vgain = _mm_set1_ps(gain);
+	for (; n + 4 <= numSamples; n += 4)
+		_mm_storeu_ps(out + n, _mm_add_ps(_mm_loadu_ps(out + n), _mm_mul_ps(_mm_loadu_ps(buf + n), vgain)));
+#endif
+	for (; n != numSamples; n++)
+		out[n] += buf[n] * gain;
+}
+
+// Adds buf panned by the two gains to interleaved stereo output
+static void tsf_voice_mix_interleaved(float* out, const float* buf, int numSamples, float gainLeft, float gainRight)
+{
+	int n = 0;
+#if defined(TSF_SIMD_NEON)
+	float32x4_t vgainLeft = vdupq_n_f32(gainLeft), vgainRight = vdupq_n_f32(gainRight);
+	for (; n + 4 <= numSamples; n += 4)
+	{
+		float32x4_t val = vld1q_f32(buf + n);
+		float32x4x2_t lr = vld2q_f32(out + n * 2);
+		lr.val[0] = vaddq_f32(lr.val[0], vmulq_f32(val, vgainLeft));
+		lr.val[1] = vaddq_f32(lr.val[1], vmulq_f32(val, vgainRight));
+		vst2q_f32(out + n * 2, lr);
+	}
+#elif defined(TSF_SIMD_SSE)
+	__m128 vgainLeft = _mm_set1_ps(gainLeft), vgainRight = _mm_set1_ps(gainRight);
+	for (; n + 4 <= numSamples; n += 4)
+	{
+		__m128 val = _mm_loadu_ps(buf + n), l = _mm_mul_ps(val, vgainLeft), r = _mm_mul_ps(val, vgainRight);
+		_mm_storeu_ps(out + n * 2,     _mm_add_ps(_mm_loadu_ps(out + n * 2),     _mm_unpacklo_ps(l, r)));
+		_mm_storeu_ps(out + n * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + n * 2 + 4), _mm_unpackhi_ps(l, r)));
+	}
+#endif
+	for (; n != numSamples; n++)
+	{
+		out[n * 2]     += buf[n] * gainLeft;
+		out[n * 2 + 1] += buf[n] * gainRight;
+	}
+}
+
+// Caches what rendering needs from the region, called once the voice is set up
+static void tsf_voice_setuprender(struct tsf_voice* v, struct tsf_voice_hot* h)
+{
+	struct tsf_region* region = v->region;
+	h->updateModEnv = (region->modEnvToPitch || region->modEnvToFilterFc);
+	h->updateModLFO = (h->modlfo.delta && (region->modLfoToPitch || region->modLfoToFilterFc || region->modLfoToVolume));
+	h->updateVibLFO = (h->viblfo.delta && (region->vibLfoToPitch));
+
+	h->dynamicLowpass = (region->modLfoToFilterFc || region->modEnvToFilterFc);
+	h->initialFilterFc = (float)region->initialFilterFc, h->modLfoToFilterFc = (float)region->modLfoToFilterFc, h->modEnvToFilterFc = (float)region->modEnvToFilterFc;
+
+	h->dynamicPitchRatio = (region->modLfoToPitch || region->modEnvToPitch || region->vibLfoToPitch);
+	h->modLfoToPitch = (float)region->modLfoToPitch, h->vibLfoToPitch = (float)region->vibLfoToPitch, h->modEnvToPitch = (float)region->modEnvToPitch;
+
+	h->dynamicGain = (region->modLfoToVolume != 0);
+	h->modLfoToVolume = (float)region->modLfoToVolume * 0.1f;
+	h->noteGain = tsf_decibelsToGain(h->noteGainDB);
+}
+
+// Sets up a voice playing a sample with a streamed middle: through a free ring, from the tail alone
+// if it starts there, or else cut off at the end of the head
+static void tsf_voice_stream_start(tsf* f, struct tsf_voice_hot* h, struct tsf_samplerange* r)
+{
+	unsigned int streamStart = r->streamStart - r->start, streamEnd = r->streamEnd - r->start;
+	struct tsf_streamring* s;
+	int i;
+	if (h->sampleEnd <= streamStart) return;
+	if (h->phaseInt >= streamEnd)
+	{
+		h->samples = r->tail, h->phaseInt -= streamEnd, h->sampleEnd -= streamEnd;
+		if (h->loopStart < h->loopEnd) h->loopStart -= streamEnd, h->loopEnd -= streamEnd;
+		return;
+	}
+	for (i = 0; i != f->streamRingNum && f->streamRings[i].state != TSF_STREAM_FREE; i++) {}
+	if (i == f->streamRingNum)
+	{
+		h->sampleEnd = streamStart, h->loopStart = h->loopEnd = 0;
+		return;
+	}
+	s = &f->streamRings[i];
+	s->start = r->start;
+	s->filled = s->consumed = (h->phaseInt > streamStart ? h->phaseInt : streamStart);
+	s->to = streamEnd + 1;
+	TSF_STREAM_BARRIER();
+	s->state = TSF_STREAM_PLAYING;
+	h->stream = i, h->tail = r->tail, h->streamStart = streamStart, h->streamEnd = streamEnd;
+}
+
+// Interpolates a streaming voice from its resident head, its ring and its resident tail (which holds any loop).
+// Returns early without moving on if the I/O thread hasn't caught up.
+static int tsf_voice_interpolate_streamed(tsf* f, struct tsf_voice_hot* h, float* buf, int numSamples)
+{
+	struct tsf_streamring* s = &f->streamRings[h->stream];
+	int n = 0;
+	while (n != numSamples && h->phaseInt < h->sampleEnd)
+	{
+		unsigned int pos = h->phaseInt, index, count;
+		if (pos < h->streamStart)
+		{
+			n += tsf_voice_interpolate(h->samples, buf + n, numSamples - n, &h->phaseInt, &h->phaseFrac, h->pitchRatio, h->streamStart, 0, 0, TSF_FALSE);
+		}
+		else if (pos < h->streamEnd)
+		{
+			// Play what is filled and in one piece in the ring, keeping the last sample for interpolation
+			index = pos & (TSF_STREAM_RING - 1);
+			count = s->filled;
+			TSF_STREAM_BARRIER();
+			if (count < pos + 2) break;
+			count -= pos;
+			if (count > TSF_STREAM_RING + TSF_STREAM_GUARD - index) count = TSF_STREAM_RING + TSF_STREAM_GUARD - index;
+			pos = index;
+			n += tsf_voice_interpolate(s->ring, buf + n, numSamples - n, &pos, &h->phaseFrac, h->pitchRatio, index + count - 1, 0, 0, TSF_FALSE);
+			h->phaseInt += pos - index;
+			TSF_STREAM_BARRIER();
+			s->consumed = h->phaseInt;
+		}
+		else
+		{
+			pos -= h->streamEnd;
+			n += tsf_voice_interpolate(h->tail, buf + n, numSamples - n, &pos, &h->phaseFrac, h->pitchRatio, h->sampleEnd - h->streamEnd, h->loopStart - h->streamEnd, h->loopEnd - h->streamEnd, h->loopStart < h->loopEnd);
+			h->phaseInt = pos + h->streamEnd;
+			break;
+		}
+	}
+	return n;
+}
+
+// Advances the voice's modulators by one effect block and interpolates its source into buf.
+// Returns the number of frames produced (fewer if the sample ended), the rest of buf is zeroed.
+static int tsf_voice_render_block(tsf* f, struct tsf_voice_hot* h, float* buf, int blockSamples, float* gainMono)
+{
+	float tmpSampleRate = f->outSampleRate;
+	int n;
+
+	if (h->dynamicLowpass)
+	{
+		float fres = h->initialFilterFc + h->modlfo.level * h->modLfoToFilterFc + h->modenv.level * h->modEnvToFilterFc;
+		float lowpassFc = (fres <= 13500 ? tsf_cents2Hertz(fres) / tmpSampleRate : 1.0f);
+		h->lowpass.active = (lowpassFc < 0.499f);
+		if (h->lowpass.active) tsf_voice_lowpass_setup(&h->lowpass, lowpassFc);
+	}
+
+	if (h->dynamicPitchRatio)
+		h->pitchRatio = tsf_timecents2Secsd(h->pitchInputTimecents + (h->modlfo.level * h->modLfoToPitch + h->viblfo.level * h->vibLfoToPitch + h->modenv.level * h->modEnvToPitch)) * h->pitchOutputFactor;
+
+	if (h->dynamicGain)
+		h->noteGain = tsf_decibelsToGain(h->noteGainDB + (h->modlfo.level * h->modLfoToVolume));
+
+	*gainMono = h->noteGain * h->ampenv.level * TSF_SAMPLE_SCALE;
+
+	// Update EG.
+	tsf_voice_envelope_process(&h->ampenv, blockSamples, tmpSampleRate);
+	if (h->updateModEnv) tsf_voice_envelope_process(&h->modenv, blockSamples, tmpSampleRate);
+
+	// Update LFOs.
+	if (h->updateModLFO) tsf_voice_lfo_process(&h->modlfo, blockSamples);
+	if (h->updateVibLFO) tsf_voice_lfo_process(&h->viblfo, blockSamples);
+
+	if (h->stream != -1) n = tsf_voice_interpolate_streamed(f, h, buf, blockSamples);
+	else n = tsf_voice_interpolate(h->samples, buf, blockSamples, &h->phaseInt, &h->phaseFrac, h->pitchRatio, h->sampleEnd, h->loopStart, h->loopEnd, h->loopStart < h->loopEnd);
+	if (n != blockSamples) TSF_MEMSET(buf + n, 0, sizeof(float) * (blockSamples - n));
+	return n;
+}
+
+// Renders up to 4 voices block by block, so their low-pass filters can run in lock-step
+static void tsf_voice_render_group(tsf* f, struct tsf_voice** voices, int count, float* outputBuffer, int numSamples)
+{
+	struct tsf_voice_hot* hot[4];
+	struct tsf_voice_lowpass* lowpass[4];
+	float voiceBuffers[4][TSF_RENDER_EFFECTSAMPLEBLOCK], *bufs[4], gains[4];
+	float* outR = (f->outputmode == TSF_STEREO_UNWEAVED ? outputBuffer + numSamples : TSF_NULL);
+	int produced[4], lane, offset = 0;
+
+	for (lane = 0; lane != 4; lane++)
+	{
+		bufs[lane] = voiceBuffers[lane];
+		if (lane < count) hot[lane] = tsf_voice_gethot(f, voices[lane]);
+		else TSF_MEMSET(voiceBuffers[lane], 0, sizeof(voiceBuffers[lane]));
+		lowpass[lane] = TSF_NULL;
+	}
+
+	while (numSamples)
+	{
+		TSF_BOOL anyLowpass = TSF_FALSE;
+		int blockSamples = (numSamples > TSF_RENDER_EFFECTSAMPLEBLOCK ? TSF_RENDER_EFFECTSAMPLEBLOCK : numSamples);
+		numSamples -= blockSamples;
+
+		for (lane = 0; lane != count; lane++)
+		{
+			struct tsf_voice_hot* h = hot[lane];
+			lowpass[lane] = TSF_NULL;
+			if (voices[lane]->playingPreset == -1) { produced[lane] = 0; continue; } // ended in an earlier block
+			produced[lane] = tsf_voice_render_block(f, h, bufs[lane], blockSamples, &gains[lane]);
+			if (h->lowpass.active) lowpass[lane] = &h->lowpass, anyLowpass = TSF_TRUE;
+		}
+
+		// Low-pass filter.
+		if (anyLowpass) tsf_voice_lowpass_process4(lowpass, bufs, blockSamples);
+
+		for (lane = 0; lane != count; lane++)
+		{
+			struct tsf_voice_hot* h = hot[lane];
+			float gainMono = gains[lane];
+			if (voices[lane]->playingPreset == -1) continue;
+
+			switch (f->outputmode)
+			{
+				case TSF_STEREO_INTERLEAVED:
+					tsf_voice_mix_interleaved(outputBuffer + offset * 2, bufs[lane], produced[lane], gainMono * h->panFactorLeft, gainMono * h->panFactorRight);
+					break;
+
+				case TSF_STEREO_UNWEAVED:
+					tsf_voice_mix_mono(outputBuffer + offset, bufs[lane], produced[lane], gainMono * h->panFactorLeft);
+					tsf_voice_mix_mono(outR + offset, bufs[lane], produced[lane], gainMono * h->panFactorRight);
+					break;
+
+				case TSF_MONO:
+					tsf_voice_mix_mono(outputBuffer + offset, bufs[lane], produced[lane], gainMono);
+					break;
+			}
+
+			if (h->phaseInt >= h->sampleEnd || h->ampenv.segment == TSF_SEGMENT_DONE)
+				tsf_voice_kill(f, voices[lane]);
+		}
+		offset += blockSamples;
+	}
+}
+
+#ifndef TSF_NO_STDIO
+// Sets up the sample ranges to page in, each covering what its regions can read (plus one for interpolation)
+static int tsf_load_sampleranges(tsf* f, int sampleNum, tsf_u32 smplCount)
+{
+	struct tsf_preset *preset, *presetEnd;
+	int i;
+	f->sampleRanges = (struct tsf_samplerange*)TSF_MALLOC(sampleNum * sizeof(struct tsf_samplerange));
+	if (!f->sampleRanges) return 0;
+	for (i = 0; i != sampleNum; i++)
+	{
+		f->sampleRanges[i].start = 0xFFFFFFFF;
+		f->sampleRanges[i].end = f->sampleRanges[i].streamStart = f->sampleRanges[i].streamEnd = 0;
+		f->sampleRanges[i].data = f->sampleRanges[i].tail = TSF_NULL;
+	}
+	for (preset = f->presets, presetEnd = preset + f->presetNum; preset != presetEnd; preset++)
+	{
+		struct tsf_region *region, *regionEnd;
+		for (region = preset->regions, regionEnd = region + preset->regionNum; region != regionEnd; region++)
+		{
+			struct tsf_samplerange* r = &f->sampleRanges[region->sampleIndex];
+			tsf_u32 start = region->offset, end = region->end + 1;
+			if (region->loop_mode != TSF_LOOPMODE_NONE && region->loop_start < region->loop_end)
+			{
+				if (region->loop_start < start) start = region->loop_start;
+				if (region->loop_end + 2 > end) end = region->loop_end + 2;
+			}
+			if (end > smplCount) end = smplCount;
+			if (start < r->start) r->start = start;
+			if (end > r->end) r->end = end;
+		}
+	}
+	return 1;
+}
+#endif
+
+// Reads the whole pdta list with one call and decodes its sub-chunks into one block the hydra arrays
+// point into. Two walks over the sub-chunks, the first one only adds up the size of the block.
+static int tsf_load_hydra(struct tsf_hydra* hydra, void** pHydraBlock, struct tsf_riffchunk* chunkList, struct tsf_stream* stream)
+{
+	enum
+	{
+		phdrSizeInFile = 38, pbagSizeInFile =  4, pmodSizeInFile = 10,
+		pgenSizeInFile =  4, instSizeInFile = 22, ibagSizeInFile =  4,
+		imodSizeInFile = 10, igenSizeInFile =  4, shdrSizeInFile = 46
+	};
+	struct tsf_stream_memory list = { TSF_NULL, 0, 0 };
+	struct tsf_stream listStream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
+	char *buffer = (char*)TSF_MALLOC(chunkList->size ? chunkList->size : 1), *block = TSF_NULL;
+	size_t blockSize = 0;
+	int pass;
+	if (!buffer) return 0;
+	if (stream->read(stream->data, buffer, chunkList->size) != (int)chunkList->size) { TSF_FREE(buffer); return 0; }
+	list.buffer = buffer;
+	list.total = chunkList->size;
+	listStream.data = &list;
+	for (pass = 0; pass != 2; pass++)
+	{
+		struct tsf_riffchunk parent = *chunkList, chunk;
+		if (pass && !(block = (char*)TSF_MALLOC(blockSize ? blockSize : 1))) { TSF_FREE(buffer); return 0; }
+		list.pos = 0;
+		blockSize = 0;
+		while (tsf_riffchunk_read(&parent, &chunk, &listStream))
+		{
+			const char* p = list.buffer + list.pos;
+			#define HandleChunk(chunkName) (TSF_FourCCEquals(chunk.id, #chunkName) && !(chunk.size % chunkName##SizeInFile)) \
+				{ \
+					int num = chunk.size / chunkName##SizeInFile, i; \
+					if (pass) \
+					{ \
+						hydra->chunkName##Num = num; \
+						hydra->chunkName##s = (struct tsf_hydra_##chunkName*)(block + blockSize); \
+						for (i = 0; i < num; ++i) tsf_hydra_read_##chunkName(&hydra->chunkName##s[i], &p); \
+					} \
+					blockSize += (num * sizeof(struct tsf_hydra_##chunkName) + 7) & ~(size_t)7; \
+				}
+			if      HandleChunk(phdr) else if HandleChunk(pbag) else if HandleChunk(pmod)
+			else if HandleChunk(pgen) else if HandleChunk(inst) else if HandleChunk(ibag)
+			else if HandleChunk(imod) else if HandleChunk(igen) else if HandleChunk(shdr)
+			#undef HandleChunk
+			listStream.skip(&list, chunk.size); // past the sub-chunk, decoded or not
+		}
+	}
+	TSF_FREE(buffer);
+	*pHydraBlock = block;
+	return 1;
+}
+
+static tsf* tsf_load_internal(struct tsf_stream* stream, void* pagedFile)
+{
+	tsf* res = TSF_NULL;
+	struct tsf_riffchunk chunkHead;
+	struct tsf_riffchunk chunkList;
+	struct tsf_hydra hydra;
+	void* rawBuffer = TSF_NULL;
+	tsf_sample* sampleBuffer = TSF_NULL;
+	void* hydraBlock = TSF_NULL; // the hydra arrays point into it
+	tsf_u32 smplCount = 0;
+	tsf_s64 smplOffset = -1;
+	TSF_BOOL skipped = TSF_TRUE; // reading on after a failed skip would start at the wrong place
+
+	TSF_RT_LEAVE();
+	if (!tsf_riffchunk_read(TSF_NULL, &chunkHead, stream) || !TSF_FourCCEquals(chunkHead.id, "sfbk"))
+	{
+		//if (e) *e = TSF_INVALID_NOSF2HEADER;
+		fprintf(stderr, "TSF_INVALID_NOSF2HEADER\n");
+
+		return res;
+	}
+
+	// Read hydra and locate sample data.
+	TSF_MEMSET(&hydra, 0, sizeof(hydra));
+	while (skipped && tsf_riffchunk_read(&chunkHead, &chunkList, stream))
+	{
+		struct tsf_riffchunk chunk;
+		if (TSF_FourCCEquals(chunkList.id, "pdta"))
+		{
+			if (!hydraBlock && !tsf_load_hydra(&hydra, &hydraBlock, &chunkList, stream)) goto out_of_memory;
+		}
+		else if (TSF_FourCCEquals(chunkList.id, "sdta"))
+		{
+			while (skipped && tsf_riffchunk_read(&chunkList, &chunk, stream))
+			{
+				if ((TSF_FourCCEquals(chunk.id, "smpl")
+						#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
+						|| TSF_FourCCEquals(chunk.id, "smpo")
+						#endif
+					) && !rawBuffer && !sampleBuffer && smplOffset < 0 && chunk.size >= sizeof(short))
+				{
+					#ifndef TSF_NO_STDIO
+					if (pagedFile && TSF_FourCCEquals(chunk.id, "smpl"))
+					{
+						// Only remember where the samples are, none if they end past where the file can seek to
+						TSF_FILEOFF pos = TSF_FTELL((FILE*)pagedFile);
+						skipped = (pos >= 0 && tsf_file_seek((FILE*)pagedFile, (tsf_s64)pos + chunk.size));
+						if (skipped) { smplOffset = pos; smplCount = chunk.size / (unsigned int)sizeof(short); }
+						continue;
+					}
+					#endif
+					if (!tsf_load_samples(&rawBuffer, &sampleBuffer, &smplCount, &chunk, stream)) goto out_of_memory;
+				}
+				else skipped = stream->skip(stream->data, chunk.size);
+			}
+		}
+		else skipped = stream->skip(stream->data, chunkList.size);
+	}
+	if (!hydra.phdrs || !hydra.pbags || !hydra.pmods || !hydra.pgens || !hydra.insts || !hydra.ibags || !hydra.imods || !hydra.igens || !hydra.shdrs)
+	{
+		//if (e) *e = TSF_INVALID_INCOMPLETE;
+		fprintf(stderr, "TSF_INVALID_INCOMPLETE\n");
+	}
+	else if (!rawBuffer && !sampleBuffer && smplOffset < 0)
+	{
+		//if (e) *e = TSF_INVALID_NOSAMPLEDATA;
+		fprintf(stderr, "TSF_INVALID_NOSAMPLEDATA\n");
+	}
+	else
+	{
+		#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
+		if (!sampleBuffer && smplOffset < 0 && !tsf_decode_sf3_samples(rawBuffer, &sampleBuffer, &smplCount, &hydra)) goto out_of_memory;
+		#endif
+		res = (tsf*)TSF_MALLOC(sizeof(tsf));
+		if (res) TSF_MEMSET(res, 0, sizeof(tsf));
+		if (!res || !tsf_load_presets(res, &hydra, smplCount)) goto out_of_memory;
+		tsf_load_presetlookup(res);
+		if (!tsf_load_regionindex(res)) { tsf_close(res); res = TSF_NULL; goto out_of_memory; }
+		res->outSampleRate = 44100.0f;
+		tsf_voice_lists_init(&res->releaseVoices, 1);
+		tsf_voice_lists_init(res->keyVoices, 128);
+		tsf_voice_lists_init(&res->groupVoices, 1);
+		res->fontSamples = sampleBuffer;
+		res->fontSampleNum = smplCount;
+		sampleBuffer = TSF_NULL; // don't free below
+		#ifndef TSF_NO_STDIO
+		if (smplOffset >= 0)
+		{
+			if (!tsf_load_sampleranges(res, hydra.shdrNum, smplCount)) { tsf_close(res); res = TSF_NULL; goto out_of_memory; }
+			res->sampleRangeNum = hydra.shdrNum;
+			res->sampleFile = pagedFile;
+			res->sampleFileOffset = smplOffset;
+		}
+		#endif
+	}
+	if (0)
+	{
+		out_of_memory:
+		TSF_FREE(res);
+		res = TSF_NULL;
+		fprintf(stderr, "OOM\n");
+		//if (e) *e = TSF_OUT_OF_MEMORY;
+	}
+	TSF_FREE(hydraBlock);
+	TSF_FREE(rawBuffer); TSF_FREE(sampleBuffer);
+	return res;
+}
+
+TSFDEF tsf* tsf_load(struct tsf_stream* stream)
+{
+	return tsf_load_internal(stream, TSF_NULL);
+}
+
+#ifndef TSF_NO_STDIO
+TSFDEF tsf* tsf_load_filename_paged(const char* filename)
+{
+	tsf* res;
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_stdio_read, (int(*)(void*,unsigned int))&tsf_stream_stdio_skip };
+	#if __STDC_WANT_SECURE_LIB__
+	FILE* f = TSF_NULL; fopen_s(&f, filename, "rb");
+	#else
+	FILE* f = fopen(filename, "rb");
+	#endif
+	if (!f)
+	{
+		//if (e) *e = TSF_FILENOTFOUND;
+		fprintf(stderr, "TSF_FILENOTFOUND\n");
+
+		return TSF_NULL;
+	}
+	stream.data = f;
+	res = tsf_load_internal(&stream, f);
+	if (!res || !res->sampleFile) fclose(f);
+	return res;
+}
+
+// Reads samples from up to to of the smpl chunk into a new buffer, returns NULL on failure
+static tsf_sample* tsf_read_samples(tsf* f, tsf_u32 from, tsf_u32 to)
+{
+	tsf_u32 count = to - from;
+	// One more zeroed sample past the end for interpolation at the very end of the smpl chunk
+	tsf_sample* data = (tsf_sample*)TSF_MALLOC((count + 1) * sizeof(tsf_sample));
+	if (!data) return TSF_NULL;
+	if (!tsf_file_seek((FILE*)f->sampleFile, f->sampleFileOffset + (tsf_s64)from * (tsf_s64)sizeof(short))
+		|| fread(data, sizeof(short), count, (FILE*)f->sampleFile) != count) { TSF_FREE(data); return TSF_NULL; }
+	tsf_convert_samples(data, count);
+	data[count] = 0;
+	return data;
+}
+
+TSFDEF int tsf_load_preset_samples(tsf* f, int preset_index)
+{
+	struct tsf_region *region, *regionEnd;
+	TSF_RT_LEAVE();
+	if (!f->sampleRanges || preset_index < 0 || preset_index >= f->presetNum) return 1;
+	for (region = f->presets[preset_index].regions, regionEnd = region + f->presets[preset_index].regionNum; region != regionEnd; region++)
+	{
+		struct tsf_samplerange* r = &f->sampleRanges[region->sampleIndex];
+		if (r->data || r->end <= r->start) continue;
+		if (r->streamStart < r->streamEnd)
+		{
+			// The head up to and including streamStart (to interpolate into the ring) and the tail from streamEnd
+			tsf_sample *head = tsf_read_samples(f, r->start, r->streamStart + 1), *tail = (head ? tsf_read_samples(f, r->streamEnd, r->end) : TSF_NULL);
+			if (!tail) { TSF_FREE(head); return 0; }
+			r->tail = tail;
+			TSF_STREAM_BARRIER(); // note-ons on another thread start playing the range once data is set
+			r->data = head;
+		}
+		else
+		{
+			tsf_sample* data = tsf_read_samples(f, r->start, r->end);
+			if (!data) return 0;
+			TSF_STREAM_BARRIER();
+			r->data = data;
+		}
+	}
+	return 1;
+}
+
+TSFDEF int tsf_set_streaming(tsf* f, int head_ms, int max_streams)
+{
+	struct tsf_preset *preset, *presetEnd;
+	struct tsf_samplerange *r, *rEnd;
+	tsf_sample* rings;
+	int i;
+	TSF_RT_LEAVE();
+	if (!f->sampleRanges || max_streams <= 0) return 1;
+
+	// Streams start after the longest head of the regions playing a sample and end where the first of their loops starts
+	for (r = f->sampleRanges, rEnd = r + f->sampleRangeNum; r != rEnd; r++)
+		if (!r->data && r->start < r->end) r->streamStart = r->start, r->streamEnd = r->end - 1;
+	for (preset = f->presets, presetEnd = preset + f->presetNum; preset != presetEnd; preset++)
+	{
+		struct tsf_region *region, *regionEnd;
+		for (region = preset->regions, regionEnd = region + preset->regionNum; region != regionEnd; region++)
+		{
+			tsf_u32 head = (tsf_u32)((double)region->sample_rate * head_ms / 1000.0);
+			r = &f->sampleRanges[region->sampleIndex];
+			if (r->data || r->start >= r->end) continue;
+			if (region->offset + head > r->streamStart) r->streamStart = region->offset + head;
+			if (region->loop_mode != TSF_LOOPMODE_NONE && region->loop_start < region->loop_end && region->loop_start < r->streamEnd) r->streamEnd = region->loop_start;
+		}
+	}
+	// Short gaps aren't worth a ring
+	for (r = f->sampleRanges; r != rEnd; r++)
+		if (r->data || r->streamEnd < r->streamStart + TSF_STREAM_RING) r->streamStart = r->streamEnd = 0;
+
+	if (f->streamRings) return 1;
+	f->streamRings = (struct tsf_streamring*)TSF_MALLOC(max_streams * sizeof(struct tsf_streamring));
+	rings = (tsf_sample*)TSF_MALLOC(max_streams * (TSF_STREAM_RING + TSF_STREAM_GUARD) * sizeof(tsf_sample));
+	if (!f->streamRings || !rings) { TSF_FREE(f->streamRings); TSF_FREE(rings); f->streamRings = TSF_NULL; return 0; }
+	for (i = 0; i != max_streams; i++)
+	{
+		f->streamRings[i].ring = rings + i * (TSF_STREAM_RING + TSF_STREAM_GUARD);
+		f->streamRings[i].state = TSF_STREAM_FREE;
+	}
+	f->streamRingNum = max_streams;
+	return 1;
+}
+
+TSFDEF int tsf_stream_update(tsf* f)
+{
+	int i, total = 0;
+	for (i = 0; i != f->streamRingNum; i++)
+	{
+		struct tsf_streamring* s = &f->streamRings[i];
+		tsf_u32 filled, count, index;
+		if (s->state == TSF_STREAM_RETIRED) { s->state = TSF_STREAM_FREE; continue; }
+		if (s->state != TSF_STREAM_PLAYING) continue;
+		TSF_STREAM_BARRIER();
+
+		// Fill up to the ring size ahead of the voice, in one piece up to the end of the ring
+		filled = s->filled;
+		count = s->consumed + TSF_STREAM_RING;
+		if (count > s->to) count = s->to;
+		if (count <= filled) continue;
+		count -= filled;
+		index = filled & (TSF_STREAM_RING - 1);
+		if (count > TSF_STREAM_CHUNK) count = TSF_STREAM_CHUNK;
+		if (count > TSF_STREAM_RING - index) count = TSF_STREAM_RING - index;
+
+		// A failed read plays as silence rather than stalling the voice
+		if (!tsf_file_seek((FILE*)f->sampleFile, f->sampleFileOffset + ((tsf_s64)s->start + filled) * (tsf_s64)sizeof(short))
+			|| fread(s->ring + index, sizeof(short), count, (FILE*)f->sampleFile) != count) TSF_MEMSET(s->ring + index, 0, count * sizeof(short));
+		tsf_convert_samples(s->ring + index, count);
+		if (index < TSF_STREAM_GUARD) TSF_MEMCPY(s->ring + TSF_STREAM_RING + index, s->ring + index, (count < TSF_STREAM_GUARD - index ? count : TSF_STREAM_GUARD - index) * sizeof(tsf_sample));
+		TSF_STREAM_BARRIER();
+		s->filled = filled + count;
+		total += (int)count;
+	}
+	return total;
+}
+
+// Compiled fonts are a header followed by fontData and the samples. Pointers in the presets are
+// stored as offsets into the regions and the region index and fixed up when loading.
+#define TSF_COMPILED_VERSION 2
+// Changes with the struct layouts and the sample type, compiled fonts only load with the same ones
+#define TSF_COMPILED_LAYOUT ((tsf_u32)((sizeof(struct tsf_region) << 16) | (sizeof(struct tsf_preset) << 4) | sizeof(tsf_sample)))
+struct tsf_compiled_header { char magic[4]; tsf_u32 version, layout, presetNum, regionNum, lookupNum, indexNum, sampleNum; tsf_s64 sourceSize, sourceTime; };
+
+// Adds count entries of entrySize bytes to *size, returns 0 if that doesn't fit in a size_t
+static int tsf_size_add(size_t* size, tsf_u32 count, size_t entrySize)
+{
+	if (count > ((size_t)-1 - *size) / entrySize) return 0;
+	*size += (size_t)count * entrySize;
+	return 1;
+}
+
+// Opens a compiled font file and reads its header, returns NULL if it isn't one written by this build
+static FILE* tsf_compiled_open(const char* filename, struct tsf_compiled_header* header)
+{
+	#if __STDC_WANT_SECURE_LIB__
+	FILE* file = TSF_NULL; fopen_s(&file, filename, "rb");
+	#else
+	FILE* file = fopen(filename, "rb");
+	#endif
+	if (!file) return TSF_NULL;
+	if (fread(header, sizeof(*header), 1, file) != 1 || header->magic[0] != 'T' || header->magic[1] != 'S' || header->magic[2] != 'F' || header->magic[3] != 'C'
+		|| header->version != TSF_COMPILED_VERSION || header->layout != TSF_COMPILED_LAYOUT || !header->lookupNum || (header->lookupNum & (header->lookupNum - 1)))
+	{
+		fclose(file);
+		return TSF_NULL;
+	}
+	return file;
+}
+
+TSFDEF int tsf_save_compiled(const tsf* f, const char* filename, long long source_size, long long source_time)
+{
+	struct tsf_compiled_header header = { { 'T', 'S', 'F', 'C' }, TSF_COMPILED_VERSION, TSF_COMPILED_LAYOUT, 0, 0, 0, 0, 0, 0, 0 };
+	struct tsf_preset* presets;
+	const int* index;
+	size_t size;
+	FILE* file;
+	int i, ok;
+	TSF_RT_LEAVE();
+	if (!f || !f->fontSamples) return 0;
+	presets = (struct tsf_preset*)TSF_MALLOC((f->presetNum ? f->presetNum : 1) * sizeof(struct tsf_preset));
+	if (!presets) return 0;
+	index = f->presetLookup + f->presetLookupMask + 1;
+	for (i = 0; i != f->presetNum; i++)
+	{
+		const struct tsf_preset* preset = &f->presets[i];
+		int bandNum = (int)(preset->bandStart - preset->bandHivel);
+		presets[i] = *preset;
+		presets[i].regions = (struct tsf_region*)(size_t)(preset->regions - f->regions);
+		presets[i].keyBands = (int*)(size_t)(preset->keyBands - index);
+		presets[i].bandHivel = (int*)(size_t)(preset->bandHivel - index);
+		presets[i].bandStart = (int*)(size_t)(preset->bandStart - index);
+		presets[i].regionList = (int*)(size_t)(preset->regionList - index);
+		header.regionNum += preset->regionNum;
+		header.indexNum = (tsf_u32)(preset->regionList + preset->bandStart[bandNum] - index);
+	}
+	header.presetNum = f->presetNum;
+	header.lookupNum = f->presetLookupMask + 1;
+	header.sampleNum = f->fontSampleNum;
+	header.sourceSize = source_size;
+	header.sourceTime = source_time;
+	size = tsf_fontdata_size(f->presetNum, header.regionNum, header.lookupNum, header.indexNum) - f->presetNum * sizeof(struct tsf_preset);
+
+	#if __STDC_WANT_SECURE_LIB__
+	file = TSF_NULL; fopen_s(&file, filename, "wb");
+	#else
+	file = fopen(filename, "wb");
+	#endif
+	ok = (file
+		&& fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(presets, sizeof(struct tsf_preset), header.presetNum, file) == header.presetNum
+		&& fwrite(f->regions, 1, size, file) == size
+		&& fwrite(f->fontSamples, sizeof(tsf_sample), header.sampleNum, file) == header.sampleNum);
+	if (file && fclose(file)) ok = 0;
+	if (file && !ok) remove(filename);
+	TSF_FREE(presets);
+	return ok;
+}
+
+TSFDEF tsf* tsf_load_compiled(const char* filename)
+{
+	struct tsf_compiled_header header;
+	struct tsf_preset *preset, *presetEnd;
+	struct tsf_region *region, *regionEnd;
+	tsf* res = TSF_NULL;
+	size_t size = 0;
+	tsf_u32 i;
+	TSF_BOOL lookupEnds = TSF_FALSE;
+	int* index;
+	FILE* file;
+	TSF_RT_LEAVE();
+	if (!(file = tsf_compiled_open(filename, &header))) return TSF_NULL;
+	if (header.presetNum > 0x7FFFFFFF || header.regionNum > 0x7FFFFFFF
+		|| !tsf_size_add(&size, header.presetNum, sizeof(struct tsf_preset)) || !tsf_size_add(&size, header.regionNum, sizeof(struct tsf_region))
+		|| !tsf_size_add(&size, header.lookupNum, sizeof(int)) || !tsf_size_add(&size, header.indexNum, sizeof(int))
+		|| !tsf_size_add(&size, header.sampleNum, sizeof(tsf_sample)))
+		goto done;
+
+	res = (tsf*)TSF_MALLOC(sizeof(tsf));
+	if (!res) goto done;
+	TSF_MEMSET(res, 0, sizeof(tsf));
+	res->fontData = TSF_MALLOC(size);
+	if (!res->fontData || fread(res->fontData, 1, size, file) != size) goto fail;
+	res->compiled = TSF_TRUE;
+	res->presetNum = (int)header.presetNum;
+	res->presetLookupMask = header.lookupNum - 1;
+	index = tsf_fontdata_place(res, header.regionNum);
+	res->fontSamples = (tsf_sample*)(index + header.indexNum);
+	res->fontSampleNum = header.sampleNum;
+
+	// Nothing from the file is trusted: a stale or damaged file must not make note-on or rendering read out of bounds
+	for (i = 0; i != header.lookupNum; i++)
+	{
+		if (res->presetLookup[i] == -1) lookupEnds = TSF_TRUE;
+		else if (res->presetLookup[i] < 0 || res->presetLookup[i] >= res->presetNum) goto fail;
+	}
+	if (!lookupEnds) goto fail; // probing for a missing preset would never stop
+	for (region = res->regions, regionEnd = region + header.regionNum; region != regionEnd; region++)
+		if (region->offset > header.sampleNum || region->end > header.sampleNum || region->loop_start > header.sampleNum || region->loop_end > header.sampleNum) goto fail;
+	for (preset = res->presets, presetEnd = preset + res->presetNum; preset != presetEnd; preset++)
+	{
+		size_t regionOffset = (size_t)preset->regions, keyOffset = (size_t)preset->keyBands, hivelOffset = (size_t)preset->bandHivel;
+		size_t startOffset = (size_t)preset->bandStart, listOffset = (size_t)preset->regionList, bandNum = startOffset - hivelOffset, b;
+		if (preset->regionNum < 0 || regionOffset > header.regionNum || (size_t)preset->regionNum > header.regionNum - regionOffset
+			|| keyOffset > header.indexNum || header.indexNum - keyOffset < 128 || hivelOffset >= startOffset || startOffset > header.indexNum
+			|| header.indexNum - startOffset <= bandNum || listOffset > header.indexNum) goto fail;
+		preset->regions = res->regions + regionOffset;
+		preset->keyBands = index + keyOffset;
+		preset->bandHivel = index + hivelOffset;
+		preset->bandStart = index + startOffset;
+		preset->regionList = index + listOffset;
+
+		// Band searches have to end on the preset's last band, region lists within its regions
+		if (preset->bandHivel[bandNum - 1] < 127 || preset->bandStart[0] < 0 || (size_t)preset->bandStart[bandNum] > header.indexNum - listOffset) goto fail;
+		for (b = 0; b != 128; b++)
+			if (preset->keyBands[b] < 0 || (size_t)preset->keyBands[b] >= bandNum) goto fail;
+		for (b = 0; b != bandNum; b++)
+			if (preset->bandStart[b] > preset->bandStart[b + 1]) goto fail;
+		for (b = 0; b != (size_t)preset->bandStart[bandNum]; b++)
+			if (preset->regionList[b] < 0 || preset->regionList[b] >= preset->regionNum) goto fail;
+	}
+	res->outSampleRate = 44100.0f;
+	tsf_voice_lists_init(&res->releaseVoices, 1);
+	tsf_voice_lists_init(res->keyVoices, 128);
+	tsf_voice_lists_init(&res->groupVoices, 1);
+	goto done;
+
+	fail:
+	TSF_FREE(res->fontData);
+	TSF_FREE(res);
+	res = TSF_NULL;
+	done:
+	fclose(file);
+	return res;
+}
+
+TSFDEF int tsf_get_compiled_source(const char* filename, long long* source_size, long long* source_time)
+{
+	struct tsf_compiled_header header;
+	FILE* file = tsf_compiled_open(filename, &header);
+	if (!file) return 0;
+	fclose(file);
+	*source_size = header.sourceSize;
+	*source_time = header.sourceTime;
+	return 1;
+}
+#endif
+
+TSFDEF tsf* tsf_copy(tsf* f)
+{
+	tsf* res;
+	if (!f) return TSF_NULL;
+	TSF_RT_LEAVE();
+	if (!f->refCount)
+	{
+		f->refCount = (int*)TSF_MALLOC(sizeof(int));
+		if (!f->refCount) return TSF_NULL;
+		*f->refCount = 1;
+	}
+	res = (tsf*)TSF_MALLOC(sizeof(tsf));
+	if (!res) return TSF_NULL;
+	TSF_MEMCPY(res, f, sizeof(tsf));
+	res->voices = TSF_NULL;
+	res->voiceHot = TSF_NULL;
+	res->voiceSlots = TSF_NULL;
+	res->streamRings = TSF_NULL;
+	res->streamRingNum = 0;
+	res->voiceNum = 0;
+	res->activeVoiceNum = 0;
+	tsf_voice_lists_init(&res->releaseVoices, 1);
+	tsf_voice_lists_init(res->keyVoices, 128);
+	tsf_voice_lists_init(&res->groupVoices, 1);
+	res->channels = TSF_NULL;
+	res->realtime = TSF_FALSE;
+	TSF_MEMSET(&res->stats, 0, sizeof(res->stats));
+	(*res->refCount)++;
+	return res;
+}
+
+TSFDEF void tsf_close(tsf* f)
+{
+	if (!f) return;
+	if (!f->refCount || !--(*f->refCount))
+	{
+		TSF_FREE(f->fontData);
+		if (!f->compiled) TSF_FREE(f->fontSamples);
+		if (f->sampleRanges)
+		{
+			int i; for (i = 0; i != f->sampleRangeNum; i++) { TSF_FREE(f->sampleRanges[i].data); TSF_FREE(f->sampleRanges[i].tail); }
+			TSF_FREE(f->sampleRanges);
+		}
+		#ifndef TSF_NO_STDIO
+		if (f->sampleFile) fclose((FILE*)f->sampleFile);
+		#endif
+		TSF_FREE(f->refCount);
+	}
+	TSF_FREE(f->channels);
+	TSF_FREE(f->voices);
+	TSF_FREE(f->voiceHot);
+	TSF_FREE(f->voiceSlots);
+	if (f->streamRings) { TSF_FREE(f->streamRings[0].ring); TSF_FREE(f->streamRings); }
+	TSF_FREE(f);
+}
+
+static void tsf_channel_clear(struct tsf_channel* c)
+{
+	c->presetIndex = c->bank = c->sustain = 0;
+	c->pitchWheel = c->midiPan = 8192;
+	c->midiVolume = c->midiExpression = 16383;
+	c->midiRPN = 0xFFFF;
+	c->midiData = 0;
+	c->panOffset = 0.0f;
+	c->gainDB = c->appliedGainDB = 0.0f;
+	c->pitchRange = 2.0f;
+	c->tuning = 0.0f;
+	c->dirty = 0;
+	tsf_voice_lists_init(&c->voices, 1);
+}
+
+TSFDEF void tsf_reset(tsf* f)
+{
+	int i;
+	TSF_RT_ENTER(f);
+	for (i = 0; i != f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->voiceSlots[i]];
+		struct tsf_voice_hot* h = tsf_voice_gethot(f, v);
+		if (h->ampenv.segment < TSF_SEGMENT_RELEASE || h->ampenv.parameters.release)
+			tsf_voice_endquick(f, v);
+		// The channel lists go away with the channels
+		v->linked &= ~(1 << TSF_VOICELIST_CHANNEL);
+	}
+	if (f->channels && f->realtime) { for (i = 0; i != f->channels->channelNum; i++) tsf_channel_clear(&f->channels->channels[i]); }
+	else if (f->channels) { TSF_FREE(f->channels); f->channels = TSF_NULL; }
+}
+
+TSFDEF int tsf_get_presetindex(const tsf* f, int bank, int preset_number)
+{
+	unsigned int i;
+	if ((unsigned int)bank > 0xFFFF || (unsigned int)preset_number > 0xFFFF) return -1;
+	for (i = TSF_PRESET_HASH(bank, preset_number) & f->presetLookupMask; f->presetLookup[i] != -1; i = (i + 1) & f->presetLookupMask)
+	{
+		const struct tsf_preset* preset = &f->presets[f->presetLookup[i]];
+		if (preset->preset == preset_number && preset->bank == bank)
+			return f->presetLookup[i];
+	}
+	return -1;
+}
+
+TSFDEF int tsf_get_presetcount(const tsf* f)
+{
+	return f->presetNum;
+}
+
+TSFDEF const char* tsf_get_presetname(const tsf* f, int preset)
+{
+	return (preset < 0 || preset >= f->presetNum ? TSF_NULL : f->presets[preset].presetName);
+}
+
+TSFDEF const char* tsf_bank_get_presetname(const tsf* f, int bank, int preset_number)
+{
+	return tsf_get_presetname(f, tsf_get_presetindex(f, bank, preset_number));
+}
+
+TSFDEF void tsf_set_output(tsf* f, enum TSFOutputMode outputmode, int samplerate, float global_gain_db)
+{
+	f->outputmode = outputmode;
+	f->outSampleRate = (float)(samplerate >= 1 ? samplerate : 44100.0f);
+	f->globalGainDB = global_gain_db;
+}
+
+TSFDEF void tsf_set_volume(tsf* f, float global_volume)
+{
+	f->globalGainDB = (global_volume == 1.0f ? 0 : -tsf_gainToDecibels(1.0f / global_volume));
+}
+
+// Grows the voice slots (bookkeeping, render state and active list alike), new slots are free
+static int tsf_voices_grow(tsf* f, int newVoiceNum)
+{
+	struct tsf_voice *newVoices;
+	struct tsf_voice_hot *newVoiceHot;
+	int *newVoiceSlots, i = f->voiceNum;
+	if (newVoiceNum <= f->voiceNum) return 1;
+	newVoices = (struct tsf_voice*)TSF_REALLOC(f->voices, newVoiceNum * sizeof(struct tsf_voice));
+	if (!newVoices) return 0;
+	f->voices = newVoices;
+	newVoiceHot = (struct tsf_voice_hot*)TSF_REALLOC(f->voiceHot, newVoiceNum * sizeof(struct tsf_voice_hot));
+	if (!newVoiceHot) return 0;
+	f->voiceHot = newVoiceHot;
+	newVoiceSlots = (int*)TSF_REALLOC(f->voiceSlots, newVoiceNum * sizeof(int));
+	if (!newVoiceSlots) return 0;
+	f->voiceSlots = newVoiceSlots;
+	f->voiceNum = newVoiceNum;
+	for (; i < newVoiceNum; i++)
+	{
+		f->voices[i].playingPreset = -1;
+		f->voices[i].linked = 0;
+		f->voiceSlots[i] = i; // new voices go to the end of the free part
+	}
+	return 1;
+}
+
+TSFDEF int tsf_set_max_voices(tsf* f, int max_voices)
+{
+	TSF_RT_LEAVE();
+	if (!tsf_voices_grow(f, max_voices)) return 0;
+	f->maxVoiceNum = f->voiceNum;
+	return 1;
+}
+
+TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
+{
+	short midiVelocity = (short)(vel * 127);
+	int voicePlayIndex, band, listIndex, listEnd;
+	struct tsf_preset* preset;
+
+	TSF_RT_ENTER(f);
+	if (preset_index < 0 || preset_index >= f->presetNum) return 1;
+	if (vel <= 0.0f) { tsf_note_off(f, preset_index, key); return 1; }
+	if (key < 0 || key > 127 || midiVelocity > 127) return 1;
+
+	// Play all matching regions.
+	voicePlayIndex = f->voicePlayIndex++;
+	preset = &f->presets[preset_index];
+	for (band = preset->keyBands[key]; preset->bandHivel[band] < midiVelocity; band++) {}
+	for (listIndex = preset->bandStart[band], listEnd = preset->bandStart[band + 1]; listIndex != listEnd; listIndex++)
+	{
+		struct tsf_region* region = &preset->regions[preset->regionList[listIndex]];
+		struct tsf_voice *voice, *v; struct tsf_voice_hot* h; TSF_BOOL doLoop; float lowpassFilterQDB, lowpassFc;
+		const tsf_sample* samples = f->fontSamples; unsigned int base = 0; struct tsf_samplerange* streamed = TSF_NULL;
+
+		if (f->sampleRanges)
+		{
+			// Paged samples index from the start of their range, skip regions that weren't loaded
+			struct tsf_samplerange* r = &f->sampleRanges[region->sampleIndex];
+			if (!r->data) continue;
+			TSF_STREAM_BARRIER(); // pairs with tsf_load_preset_samples, the samples and tail are in once data is set
+			samples = r->data, base = r->start;
+			if (r->streamStart < r->streamEnd) streamed = r;
+		}
+
+		if (region->group)
+		{
+			int i;
+			for (i = f->groupVoices.first; i != -1; i = v->links[TSF_VOICELIST_GROUP].next)
+			{
+				v = &f->voices[i];
+				if (v->playingPreset == preset_index && v->region->group == region->group) tsf_voice_endquick(f, v);
+			}
+		}
+
+		voice = tsf_voice_alloc(f);
+		if (!voice)
+		{
+			if (f->maxVoiceNum)
+			{
+				// Voices have been pre-allocated and limited to a maximum, kill off the voice furthest into its release envelope
+				if (f->releaseVoices.first == -1) { f->stats.refusedVoices++; continue; }
+				tsf_voice_kill(f, &f->voices[f->releaseVoices.first]);
+				f->stats.stolenVoices++;
+			}
+			else
+			{
+				// Allocate more voices so we don't need to kill one off, growing by half keeps this rare
+				if (!tsf_voices_grow(f, f->voiceNum + (f->voiceNum > 8 ? f->voiceNum / 2 : 4))) { f->stats.refusedVoices++; return 0; }
+			}
+			voice = tsf_voice_alloc(f);
+		}
+
+		h = tsf_voice_gethot(f, voice);
+		voice->region = region;
+		voice->playingPreset = preset_index;
+		voice->playingKey = key;
+		voice->playIndex = voicePlayIndex;
+		voice->heldSustain = 0;
+		voice->playingChannel = -1;
+		h->noteGainDB = f->globalGainDB - region->attenuation - tsf_gainToDecibels(1.0f / vel);
+
+		if (f->channels)
+		{
+			f->channels->setupVoice(f, voice);
+		}
+		else
+		{
+			tsf_voice_calcpitchratio(voice, h, 0, f->outSampleRate);
+			// The SFZ spec is silent about the pan curve, but a 3dB pan law seems common. This sqrt() curve matches what Dimension LE does; Alchemy Free seems closer to sin(adjustedPan * pi/2).
+			h->panFactorLeft  = TSF_SQRTF(0.5f - region->pan);
+			h->panFactorRight = TSF_SQRTF(0.5f + region->pan);
+		}
+
+		// Offset/end.
+		h->samples = samples;
+		h->phaseInt = region->offset - base;
+		h->phaseFrac = 0;
+		h->sampleEnd = (region->end > base ? region->end - base : 0);
+
+		// Loop.
+		doLoop = (region->loop_mode != TSF_LOOPMODE_NONE && region->loop_start < region->loop_end);
+		h->loopStart = (doLoop ? region->loop_start - base : 0);
+		h->loopEnd = (doLoop ? region->loop_end - base : 0);
+		h->stream = -1;
+		if (streamed) tsf_voice_stream_start(f, h, streamed);
+
+		// Setup envelopes.
+		tsf_voice_envelope_setup(&h->ampenv, &region->ampenv, key, midiVelocity, TSF_TRUE, f->outSampleRate);
+		tsf_voice_envelope_setup(&h->modenv, &region->modenv, key, midiVelocity, TSF_FALSE, f->outSampleRate);
+
+		// Setup lowpass filter.
+		lowpassFc = (region->initialFilterFc <= 13500 ? tsf_cents2Hertz((float)region->initialFilterFc) / f->outSampleRate : 1.0f);
+		lowpassFilterQDB = region->initialFilterQ / 10.0f;
+		h->lowpass.QInv = (float)(1.0 / TSF_POW(10.0, (lowpassFilterQDB / 20.0)));
+		h->lowpass.z1 = h->lowpass.z2 = 0;
+		h->lowpass.active = (lowpassFc < 0.499f);
+		if (h->lowpass.active) tsf_voice_lowpass_setup(&h->lowpass, lowpassFc);
+
+		// Setup LFO filters.
+		tsf_voice_lfo_setup(&h->modlfo, region->delayModLFO, region->freqModLFO, f->outSampleRate);
+		tsf_voice_lfo_setup(&h->viblfo, region->delayVibLFO, region->freqVibLFO, f->outSampleRate);
+
+		tsf_voice_setuprender(voice, h);
+
+		tsf_voice_link(f, voice, TSF_VOICELIST_KEY);
+		if (voice->playingChannel != -1) tsf_voice_link(f, voice, TSF_VOICELIST_CHANNEL);
+		if (region->group) tsf_voice_link(f, voice, TSF_VOICELIST_GROUP);
+	}
+	return 1;
+}
+
+TSFDEF int tsf_bank_note_on(tsf* f, int bank, int preset_number, int key, float vel)
+{
+	int preset_index = tsf_get_presetindex(f, bank, preset_number);
+	if (preset_index == -1) return 0;
+	return tsf_note_on(f, preset_index, key, vel);
+}
+
+TSFDEF void tsf_note_off(tsf* f, int preset_index, int key)
+{
+	struct tsf_voice *v, *vMatch = TSF_NULL;
+	int i;
+	TSF_RT_ENTER(f);
+	if (key < 0 || key > 127) return;
+	for (i = f->keyVoices[key].first; i != -1; i = v->links[TSF_VOICELIST_KEY].next)
+	{
+		//Find the voice with matching preset and the smallest play index
+		v = &f->voices[i];
+		if (v->playingPreset != preset_index || tsf_voice_gethot(f, v)->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
+		if (!vMatch || v->playIndex < vMatch->playIndex) vMatch = v;
+	}
+	if (!vMatch) return;
+	for (i = f->keyVoices[key].first; i != -1; i = v->links[TSF_VOICELIST_KEY].next)
+	{
+		//Stop all voices with matching preset and the smallest play index which was enumerated above
+		v = &f->voices[i];
+		if (v->playIndex != vMatch->playIndex || v->playingPreset != preset_index || tsf_voice_gethot(f, v)->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
+		tsf_voice_end(f, v);
+	}
+}
+
+TSFDEF int tsf_bank_note_off(tsf* f, int bank, int preset_number, int key)
+{
+	int preset_index = tsf_get_presetindex(f, bank, preset_number);
+	if (preset_index == -1) return 0;
+	tsf_note_off(f, preset_index, key);
+	return 1;
+}
+
+TSFDEF void tsf_note_off_all(tsf* f)
+{
+	int i;
+	TSF_RT_ENTER(f);
+	for (i = 0; i != f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->voiceSlots[i]];
+		if (tsf_voice_gethot(f, v)->ampenv.segment < TSF_SEGMENT_RELEASE)
+			tsf_voice_end(f, v);
+	}
+}
+
+TSFDEF int tsf_active_voice_count(tsf* f)
+{
+	return f->activeVoiceNum;
+}
+
+TSFDEF void tsf_get_stats(tsf* f, struct tsf_stats* stats)
+{
+	struct tsf_statwindow* w = &f->stats;
+	stats->activeVoices = f->activeVoiceNum;
+	stats->releasingVoices = f->releaseVoices.count;
+	stats->peakVoices = w->peakVoices;
+	stats->stolenVoices = w->stolenVoices;
+	stats->refusedVoices = w->refusedVoices;
+	stats->renderCalls = w->renderCalls;
+	stats->renderFrames = w->renderFrames;
+	stats->callTicks = (w->renderCalls ? (float)(w->renderTicks / w->renderCalls) : 0.0f);
+	stats->voiceTicks = (w->voiceFrames ? (float)(w->renderTicks / w->voiceFrames) : 0.0f);
+	stats->maxCallTicks = w->maxCallTicks;
+	TSF_MEMSET(w, 0, sizeof(*w));
+	w->peakVoices = f->activeVoiceNum;
+}
+
+static unsigned int tsf_stats_clock(void)
+{
+	#ifdef TSF_CLOCK
+	return (unsigned int)TSF_CLOCK();
+	#else
+	return 0;
+	#endif
+}
+
+// Counts a render call that started at tick 'start' with 'voices' playing
+static void tsf_stats_render(tsf* f, int samples, int voices, unsigned int start)
+{
+	struct tsf_statwindow* w = &f->stats;
+	unsigned int ticks = tsf_stats_clock() - start;
+	w->renderCalls++;
+	w->renderFrames += samples;
+	w->renderTicks += ticks;
+	w->voiceFrames += (double)voices * samples;
+	if (ticks > w->maxCallTicks) w->maxCallTicks = ticks;
+}
+
+static void tsf_channels_apply(tsf* f);
+
+static void tsf_render_voices(tsf* f, float* buffer, int samples, int flag_mixing)
+{
+	struct tsf_voice *group[4];
+	int i = f->activeVoiceNum, groupNum = 0;
+	if (f->channels && f->channels->dirty) tsf_channels_apply(f);
+	if (!flag_mixing) TSF_MEMSET(buffer, 0, (f->outputmode == TSF_MONO ? 1 : 2) * sizeof(float) * samples);
+	// Walk the active list backwards: a voice that ends gets replaced by the last entry, which is already done
+	while (i--)
+	{
+		group[groupNum++] = &f->voices[f->voiceSlots[i]];
+		if (groupNum == 4) { tsf_voice_render_group(f, group, 4, buffer, samples); groupNum = 0; }
+	}
+	if (groupNum) tsf_voice_render_group(f, group, groupNum, buffer, samples);
+}
+
+TSFDEF void tsf_render_short(tsf* f, short* buffer, int samples, int flag_mixing)
+{
+	float outputSamples[TSF_RENDER_SHORTBUFFERBLOCK];
+	int channels = (f->outputmode == TSF_MONO ? 1 : 2), maxChannelSamples = TSF_RENDER_SHORTBUFFERBLOCK / channels;
+	int totalSamples = samples, voices = f->activeVoiceNum;
+	unsigned int start = tsf_stats_clock();
+	TSF_RT_ENTER(f);
+	while (samples > 0)
+	{
+		int channelSamples = (samples > maxChannelSamples ? maxChannelSamples : samples);
+		short* bufferEnd = buffer + channelSamples * channels;
+		float *floatSamples = outputSamples;
+		tsf_render_voices(f, floatSamples, channelSamples, TSF_FALSE);
+		samples -= channelSamples;
+
+		if (flag_mixing)
+			while (buffer != bufferEnd)
+			{
+				float v = *floatSamples++;
+				int vi = *buffer + (v < -1.00004566f ? (int)-32768 : (v > 1.00001514f ? (int)32767 : (int)(v * 32767.5f)));
+				*buffer++ = (vi < -32768 ? (short)-32768 : (vi > 32767 ? (short)32767 : (short)vi));
+			}
+		else
+			while (buffer != bufferEnd)
+			{
+				float v = *floatSamples++;
+				*buffer++ = (v < -1.00004566f ? (short)-32768 : (v > 1.00001514f ? (short)32767 : (short)(v * 32767.5f)));
+			}
+	}
+	tsf_stats_render(f, totalSamples, voices, start);
+}
+
+TSFDEF void tsf_render_float(tsf* f, float* buffer, int samples, int flag_mixing)
+{
+	int voices = f->activeVoiceNum;
+	unsigned int start = tsf_stats_clock();
+	TSF_RT_ENTER(f);
+	tsf_render_voices(f, buffer, samples, flag_mixing);
+	tsf_stats_render(f, samples, voices, start);
+}
+
+static float tsf_channel_pitchshift(struct tsf_channel* c)
+{
+	return (c->pitchWheel == 8192 ? c->tuning : ((c->pitchWheel / 16383.0f * c->pitchRange * 2.0f) - c->pitchRange + c->tuning));
+}
+
+static void tsf_voice_setpan(struct tsf_voice_hot* h, float pan)
+{
+	if      (pan <= -0.5f) { h->panFactorLeft = 1.0f; h->panFactorRight = 0.0f; }
+	else if (pan >=  0.5f) { h->panFactorLeft = 0.0f; h->panFactorRight = 1.0f; }
+	else { h->panFactorLeft = TSF_SQRTF(0.5f - pan); h->panFactorRight = TSF_SQRTF(0.5f + pan); }
+}
+
+static void tsf_channel_setup_voice(tsf* f, struct tsf_voice* v)
+{
+	struct tsf_channel* c = &f->channels->channels[f->channels->activeChannel];
+	struct tsf_voice_hot* h = tsf_voice_gethot(f, v);
+	v->playingChannel = f->channels->activeChannel;
+	// A pending volume change reaches this voice with the others
+	h->noteGainDB += c->appliedGainDB;
+	tsf_voice_calcpitchratio(v, h, tsf_channel_pitchshift(c), f->outSampleRate);
+	tsf_voice_setpan(h, v->region->pan + c->panOffset);
+}
+
+// Marks a channel change for the voices to pick up at the start of the next render
+static void tsf_channel_touch(tsf* f, struct tsf_channel* c, int dirty)
+{
+	c->dirty |= dirty;
+	f->channels->dirty = TSF_TRUE;
+}
+
+// Brings the voices of changed channels up to date, once per render however many changes came in
+static void tsf_channels_apply(tsf* f)
+{
+	struct tsf_voice *v;
+	int ch, i;
+	for (ch = 0; ch != f->channels->channelNum; ch++)
+	{
+		struct tsf_channel* c = &f->channels->channels[ch];
+		float pitchShift, gainDBChange;
+		if (!c->dirty) continue;
+		pitchShift = tsf_channel_pitchshift(c);
+		gainDBChange = c->gainDB - c->appliedGainDB;
+		for (i = c->voices.first; i != -1; i = v->links[TSF_VOICELIST_CHANNEL].next)
+		{
+			struct tsf_voice_hot* h;
+			v = &f->voices[i];
+			h = tsf_voice_gethot(f, v);
+			if (c->dirty & TSF_CHANNEL_DIRTY_PITCH) tsf_voice_calcpitchratio(v, h, pitchShift, f->outSampleRate);
+			if (c->dirty & TSF_CHANNEL_DIRTY_PAN) tsf_voice_setpan(h, v->region->pan + c->panOffset);
+			if (gainDBChange != 0.0f)
+			{
+				h->noteGainDB += gainDBChange;
+				h->noteGain = tsf_decibelsToGain(h->noteGainDB);
+			}
+		}
+		c->appliedGainDB = c->gainDB;
+		c->dirty = 0;
+	}
+	f->channels->dirty = TSF_FALSE;
+}
+
+static struct tsf_channel* tsf_channel_init(tsf* f, int channel)
+{
+	int i;
+	TSF_RT_ENTER(f); // every channel function but the note ones starts here
+	if (f->channels && channel < f->channels->channelNum) return &f->channels->channels[channel];
+	// Channels past the pre-allocated ones are ignored in real-time mode, not grown
+	if (f->realtime) return TSF_NULL;
+	if (!f->channels)
+	{
+		f->channels = (struct tsf_channels*)TSF_MALLOC(sizeof(struct tsf_channels) + sizeof(struct tsf_channel) * channel);
+		if (!f->channels) return TSF_NULL;
+		f->channels->setupVoice = &tsf_channel_setup_voice;
+		f->channels->channelNum = 0;
+		f->channels->activeChannel = 0;
+		f->channels->dirty = TSF_FALSE;
+	}
+	else
+	{
+		struct tsf_channels *newChannels = (struct tsf_channels*)TSF_REALLOC(f->channels, sizeof(struct tsf_channels) + sizeof(struct tsf_channel) * channel);
+		if (!newChannels) return TSF_NULL;
+		f->channels = newChannels;
+	}
+	i = f->channels->channelNum;
+	f->channels->channelNum = channel + 1;
+	for (; i <= channel; i++)
+		tsf_channel_clear(&f->channels->channels[i]);
+	return &f->channels->channels[channel];
+}
+
+TSFDEF int tsf_set_realtime(tsf* f, int max_voices, int max_channels)
+{
+	TSF_RT_LEAVE();
+	if (!tsf_set_max_voices(f, max_voices) || (max_channels > 0 && !tsf_channel_init(f, max_channels - 1))) return 0;
+	f->realtime = TSF_TRUE;
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_presetindex(tsf* f, int channel, int preset_index)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	c->presetIndex = (unsigned short)preset_index;
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_presetnumber(tsf* f, int channel, int preset_number, int flag_mididrums)
+{
+	int preset_index;
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (flag_mididrums)
+	{
+		preset_index = tsf_get_presetindex(f, 128 | (c->bank & 0x7FFF), preset_number);
+		if (preset_index == -1) preset_index = tsf_get_presetindex(f, 128, preset_number);
+		if (preset_index == -1) preset_index = tsf_get_presetindex(f, 128, 0);
+		if (preset_index == -1) preset_index = tsf_get_presetindex(f, (c->bank & 0x7FFF), preset_number);
+	}
+	else preset_index = tsf_get_presetindex(f, (c->bank & 0x7FFF), preset_number);
+	if (preset_index == -1) preset_index = tsf_get_presetindex(f, 0, preset_number);
+	if (preset_index != -1)
+	{
+		c->presetIndex = (unsigned short)preset_index;
+		return 1;
+	}
+	return 0;
+}
+
+TSFDEF int tsf_channel_set_bank(tsf* f, int channel, int bank)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	c->bank = (unsigned short)bank;
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_bank_preset(tsf* f, int channel, int bank, int preset_number)
+{
+	int preset_index;
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	preset_index = tsf_get_presetindex(f, bank, preset_number);
+	if (preset_index == -1) return 0;
+	c->presetIndex = (unsigned short)preset_index;
+	c->bank = (unsigned short)bank;
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_pan(tsf* f, int channel, float pan)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (c->panOffset == pan - 0.5f) return 1;
+	c->panOffset = pan - 0.5f;
+	tsf_channel_touch(f, c, TSF_CHANNEL_DIRTY_PAN);
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_volume(tsf* f, int channel, float volume)
+{
+	float gainDB = tsf_gainToDecibels(volume);
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (gainDB == c->gainDB) return 1;
+	c->gainDB = gainDB;
+	tsf_channel_touch(f, c, TSF_CHANNEL_DIRTY_GAIN);
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_pitchwheel(tsf* f, int channel, int pitch_wheel)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (c->pitchWheel == pitch_wheel) return 1;
+	c->pitchWheel = (unsigned short)pitch_wheel;
+	tsf_channel_touch(f, c, TSF_CHANNEL_DIRTY_PITCH);
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_pitchrange(tsf* f, int channel, float pitch_range)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (c->pitchRange == pitch_range) return 1;
+	c->pitchRange = pitch_range;
+	if (c->pitchWheel != 8192) tsf_channel_touch(f, c, TSF_CHANNEL_DIRTY_PITCH);
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_tuning(tsf* f, int channel, float tuning)
+{
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (c->tuning == tuning) return 1;
+	c->tuning = tuning;
+	tsf_channel_touch(f, c, TSF_CHANNEL_DIRTY_PITCH);
+	return 1;
+}
+
+TSFDEF int tsf_channel_set_sustain(tsf* f, int channel, int sustain)
+{
+	struct tsf_voice *v;
+	int i;
+	struct tsf_channel *c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	if (c->sustain == sustain) return 1;
+	c->sustain = sustain;
+	// Turning on sustain does no action now, just starts note_off behaving differently
+	if (sustain) return 1;
+	// Turning off sustain, actually end voices that got a note_off and were set to heldSustain status
+	for (i = c->voices.first; i != -1; i = v->links[TSF_VOICELIST_CHANNEL].next)
+	{
+		v = &f->voices[i];
+		if (tsf_voice_gethot(f, v)->ampenv.segment < TSF_SEGMENT_RELEASE && v->heldSustain)
+			tsf_voice_end(f, v);
+	}
+	return 1;
+}
+
+TSFDEF int tsf_channel_note_on(tsf* f, int channel, int key, float vel)
+{
+	TSF_RT_ENTER(f);
+	if (!f->channels || channel >= f->channels->channelNum) return 1;
+	f->channels->activeChannel = channel;
+	if (!vel)
+	{
+		tsf_channel_note_off(f, channel, key);
+		return 1;
+	}
+	return tsf_note_on(f, f->channels->channels[channel].presetIndex, key, vel);
+}
+
+TSFDEF void tsf_channel_note_off(tsf* f, int channel, int key)
+{
+	int sustain, i;
+	struct tsf_voice *v, *vMatch = TSF_NULL;
+	TSF_RT_ENTER(f);
+	if (!f->channels || channel >= f->channels->channelNum || key < 0 || key > 127) return;
+	sustain = f->channels->channels[channel].sustain;
+	for (i = f->keyVoices[key].first; i != -1; i = v->links[TSF_VOICELIST_KEY].next)
+	{
+		//Find the voice with matching channel and the smallest play index
+		v = &f->voices[i];
+		if (v->playingChannel != channel || tsf_voice_gethot(f, v)->ampenv.segment >= TSF_SEGMENT_RELEASE || v->heldSustain) continue;
+		if (!vMatch || v->playIndex < vMatch->playIndex) vMatch = v;
+	}
+	if (!vMatch) return;
+	for (i = f->keyVoices[key].first; i != -1; i = v->links[TSF_VOICELIST_KEY].next)
+	{
+		//Stop all voices with matching channel and the smallest play index which was enumerated above
+		v = &f->voices[i];
+		if (v->playIndex != vMatch->playIndex || v->playingChannel != channel || tsf_voice_gethot(f, v)->ampenv.segment >= TSF_SEGMENT_RELEASE || v->heldSustain) continue;
+		// Don't turn off if sustain is active, just mark as held by sustain so we don't forget it
+		if (sustain)
+			v->heldSustain = 1;
+		else
+			tsf_voice_end(f, v);
+	}
+}
+
+TSFDEF void tsf_channel_note_off_all(tsf* f, int channel)
+{
+	// Ignore sustain channel settings, note_off_all overrides
+	struct tsf_voice *v;
+	int i;
+	TSF_RT_ENTER(f);
+	if (!f->channels || channel >= f->channels->channelNum) return;
+	for (i = f->channels->channels[channel].voices.first; i != -1; i = v->links[TSF_VOICELIST_CHANNEL].next)
+	{
+		v = &f->voices[i];
+		if (tsf_voice_gethot(f, v)->ampenv.segment < TSF_SEGMENT_RELEASE)
+			tsf_voice_end(f, v);
+	}
+}
+
+TSFDEF void tsf_channel_sounds_off_all(tsf* f, int channel)
+{
+	struct tsf_voice *v;
+	int i;
+	TSF_RT_ENTER(f);
+	if (!f->channels || channel >= f->channels->channelNum) return;
+	for (i = f->channels->channels[channel].voices.first; i != -1; i = v->links[TSF_VOICELIST_CHANNEL].next)
+	{
+		struct tsf_voice_hot* h;
+		v = &f->voices[i];
+		h = tsf_voice_gethot(f, v);
+		if (h->ampenv.segment < TSF_SEGMENT_RELEASE || h->ampenv.parameters.release)
+			tsf_voice_endquick(f, v);
+	}
+}
+
+TSFDEF int tsf_channel_midi_control(tsf* f, int channel, int controller, int control_value)
+{
+	struct tsf_channel* c = tsf_channel_init(f, channel);
+	if (!c) return 0;
+	switch (controller)
+	{
+		case   7 /*VOLUME_MSB*/      : c->midiVolume     = (unsigned short)((c->midiVolume     & 0x7F  ) | (control_value << 7)); goto TCMC_SET_VOLUME;
+		case  39 /*VOLUME_LSB*/      : c->midiVolume     = (unsigned short)((c->midiVolume     & 0x3F80) |  control_value);       goto TCMC_SET_VOLUME;
+		case  11 /*EXPRESSION_MSB*/  : c->midiExpression = (unsigned short)((c->midiExpression & 0x7F  ) | (control_value << 7)); goto TCMC_SET_VOLUME;
+		case  43 /*EXPRESSION_LSB*/  : c->midiExpression = (unsigned short)((c->midiExpression & 0x3F80) |  control_value);       goto TCMC_SET_VOLUME;
+		case  10 /*PAN_MSB*/         : c->midiPan        = (unsigned short)((c->midiPan        & 0x7F  ) | (control_value << 7)); goto TCMC_SET_PAN;
+		case  42 /*PAN_LSB*/         : c->midiPan        = (unsigned short)((c->midiPan        & 0x3F80) |  control_value);       goto TCMC_SET_PAN;
+		case   6 /*DATA_ENTRY_MSB*/  : c->midiData       = (unsigned short)((c->midiData       & 0x7F)   | (control_value << 7)); goto TCMC_SET_DATA;
+		case  38 /*DATA_ENTRY_LSB*/  : c->midiData       = (unsigned short)((c->midiData       & 0x3F80) |  control_value);       goto TCMC_SET_DATA;
+		case   0 /*BANK_SELECT_MSB*/ : c->bank = (unsigned short)(0x8000 | control_value); return 1; //bank select MSB alone acts like LSB
+		case  32 /*BANK_SELECT_LSB*/ : c->bank = (unsigned short)((c->bank & 0x8000 ? ((c->bank & 0x7F) << 7) : 0) | control_value); return 1;
+		case 101 /*RPN_MSB*/         : c->midiRPN = (unsigned short)(((c->midiRPN == 0xFFFF ? 0 : c->midiRPN) & 0x7F  ) | (control_value << 7)); return 1;
+		case 100 /*RPN_LSB*/         : c->midiRPN = (unsigned short)(((c->midiRPN == 0xFFFF ? 0 : c->midiRPN) & 0x3F80) |  control_value); return 1;
+		case  98 /*NRPN_LSB*/        : c->midiRPN = 0xFFFF; return 1;
+		case  99 /*NRPN_MSB*/        : c->midiRPN = 0xFFFF; return 1;
+		case  64 /*SUSTAIN*/         : tsf_channel_set_sustain(f, channel, control_value >= 64); return 1;
+		case 120 /*ALL_SOUND_OFF*/   : tsf_channel_sounds_off_all(f, channel); return 1;
+		case 123 /*ALL_NOTES_OFF*/   : tsf_channel_note_off_all(f, channel);   return 1;
+		case 121 /*ALL_CTRL_OFF*/    :
+			c->midiVolume = c->midiExpression = 16383;
+			c->midiPan = 8192;
+			c->bank = 0;
+			c->midiRPN = 0xFFFF;
+			c->midiData = 0;
+			tsf_channel_set_volume(f, channel, 1.0f);
+			tsf_channel_set_pan(f, channel, 0.5f);
+			tsf_channel_set_pitchrange(f, channel, 2.0f);
+			tsf_channel_set_tuning(f, channel, 0);
+			return 1;
+	}
+	return 1;
+TCMC_SET_VOLUME:
+	//Raising to the power of 3 seems to result in a decent sounding volume curve for MIDI
+	tsf_channel_set_volume(f, channel, TSF_POWF((c->midiVolume / 16383.0f) * (c->midiExpression / 16383.0f), 3.0f));
+	return 1;
+TCMC_SET_PAN:
+	tsf_channel_set_pan(f, channel, c->midiPan / 16383.0f);
+	return 1;
+TCMC_SET_DATA:
+	if      (c->midiRPN == 0) tsf_channel_set_pitchrange(f, channel, (c->midiData >> 7) + 0.01f * (c->midiData & 0x7F));
+	else if (c->midiRPN == 1) tsf_channel_set_tuning(f, channel, (int)c->tuning + ((float)c->midiData - 8192.0f) / 8192.0f); //fine tune
+	else if (c->midiRPN == 2 && controller == 6) tsf_channel_set_tuning(f, channel, ((float)control_value - 64.0f) + (c->tuning - (int)c->tuning)); //coarse tune
+	return 1;
+}
+
+TSFDEF int tsf_channel_get_preset_index(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->channels->channels[channel].presetIndex : 0);
+}
+
+TSFDEF int tsf_channel_get_preset_bank(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? (f->channels->channels[channel].bank & 0x7FFF) : 0);
+}
+
+TSFDEF int tsf_channel_get_preset_number(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->presets[f->channels->channels[channel].presetIndex].preset : 0);
+}
+
+TSFDEF float tsf_channel_get_pan(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->channels->channels[channel].panOffset - 0.5f : 0.5f);
+}
+
+TSFDEF float tsf_channel_get_volume(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? tsf_decibelsToGain(f->channels->channels[channel].gainDB) : 1.0f);
+}
+
+TSFDEF int tsf_channel_get_pitchwheel(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->channels->channels[channel].pitchWheel : 8192);
+}
+
+TSFDEF float tsf_channel_get_pitchrange(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->channels->channels[channel].pitchRange : 2.0f);
+}
+
+TSFDEF float tsf_channel_get_tuning(tsf* f, int channel)
+{
+	return (f->channels && channel < f->channels->channelNum ? f->channels->channels[channel].tuning : 0.0f);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TSF_IMPLEMENTATION